@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adaptive.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "policy.h"
+#include "checkpoint.h"
+#include "opt.h"
+
+/* Private Internals: */
+
+#define GHOST_BUCKETS (NUM_FRAMES * 2)
+
+/*
+ * A ghost cache replays the page references as if its policy managed a memory of
+ * NUM_FRAMES pages. It keeps which pages it would hold and what its policy needs to pick
+ * a victim among them, never their contents, so every candidate can be followed at once.
+ */
+typedef struct {
+    int keys[NUM_FRAMES];       // Page (or page table) in each slot, or -1
+    long lastUse[NUM_FRAMES];
+    int uses[NUM_FRAMES];
+    int referenced[NUM_FRAMES];
+    int next[NUM_FRAMES];       // Next slot in the same hash bucket
+    int buckets[GHOST_BUCKETS];
+    int used;
+    int hand;
+} GhostCache;
+
+int adaptiveEnabled = FALSE;
+int adaptiveWindow = 0;
+int adaptiveMargin = 0;
+int adaptivePolicies = 0;
+
+GhostCache ghosts[POLICY_COUNT];
+
+// Candidates that hit on each of the last adaptiveWindow references (a bit per policy), and
+// the hits of each candidate among them
+unsigned char* windowMasks = NULL;
+int windowHits[POLICY_COUNT];
+
+long adaptiveReferences = 0;
+long lastSwitch = 0;        // References when the active policy last changed
+long policySwitches = 0;
+
+// References each candidate's ghost cache did not hold, over the whole run
+long ghostMisses[POLICY_COUNT];
+
+/* Key of a page, or with vpn FRAME_VPN_PAGETABLE of a page table. */
+int GhostKey(int pid, int vpn) {
+    return pid * (VPN(VIRTUAL_SIZE) + 1) + vpn + 1;
+}
+
+/* Next line of the input using the page of a key, for the optimal ghost. */
+int GhostNextUse(int key) {
+    return Opt_NextUse(key / (VPN(VIRTUAL_SIZE) + 1), key % (VPN(VIRTUAL_SIZE) + 1) - 1);
+}
+
+void GhostReset(GhostCache* ghost) {
+    for (int slot = 0; slot < NUM_FRAMES; slot++) {
+        ghost->keys[slot] = -1;
+    }
+    for (int i = 0; i < GHOST_BUCKETS; i++) {
+        ghost->buckets[i] = -1;
+    }
+    ghost->used = 0;
+    ghost->hand = 0;
+}
+
+int GhostFind(GhostCache* ghost, int key) {
+    for (int slot = ghost->buckets[key % GHOST_BUCKETS]; slot != -1; slot = ghost->next[slot]) {
+        if (ghost->keys[slot] == key) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+void GhostUnlink(GhostCache* ghost, int slot) {
+    int* link = &ghost->buckets[ghost->keys[slot] % GHOST_BUCKETS];
+    while (*link != slot) {
+        link = &ghost->next[*link];
+    }
+    *link = ghost->next[slot];
+}
+
+/* Slot whose page the policy would evict to make room, or an empty slot. */
+int GhostVictim(GhostCache* ghost, int policy) {
+    if (ghost->used < NUM_FRAMES) {
+        return ghost->used++;
+    }
+    int victim = 0;
+    switch (policy) {
+    case POLICY_CLOCK:
+        while (ghost->referenced[ghost->hand] > 0) {
+            ghost->referenced[ghost->hand]--;
+            ghost->hand = (ghost->hand + 1) % NUM_FRAMES;
+        }
+        // The frame under the hand is taken as in round robin
+        /* fall through */
+    case POLICY_RR:
+        victim = ghost->hand;
+        ghost->hand = (ghost->hand + 1) % NUM_FRAMES;
+        break;
+    case POLICY_LRU:
+        for (int slot = 1; slot < NUM_FRAMES; slot++) {
+            if (ghost->lastUse[slot] < ghost->lastUse[victim]) {
+                victim = slot;
+            }
+        }
+        break;
+    case POLICY_LFU:
+        for (int slot = 1; slot < NUM_FRAMES; slot++) {
+            if (ghost->uses[slot] < ghost->uses[victim]
+                || (ghost->uses[slot] == ghost->uses[victim] && ghost->lastUse[slot] < ghost->lastUse[victim])) {
+                victim = slot;
+            }
+        }
+        break;
+    case POLICY_OPT:
+        for (int slot = 1; slot < NUM_FRAMES; slot++) {
+            if (GhostNextUse(ghost->keys[slot]) > GhostNextUse(ghost->keys[victim])) {
+                victim = slot;
+            }
+        }
+        break;
+    }
+    return victim;
+}
+
+/* Replays a reference to a page on a ghost cache. Returns TRUE if the page was held. */
+int GhostAccess(GhostCache* ghost, int policy, int key, int chances) {
+    int slot = GhostFind(ghost, key);
+    int hit = (slot != -1);
+    if (!hit) {
+        slot = GhostVictim(ghost, policy);
+        if (ghost->keys[slot] != -1) {
+            GhostUnlink(ghost, slot);
+        }
+        ghost->keys[slot] = key;
+        ghost->next[slot] = ghost->buckets[key % GHOST_BUCKETS];
+        ghost->buckets[key % GHOST_BUCKETS] = slot;
+        ghost->uses[slot] = 0;
+    }
+    ghost->lastUse[slot] = adaptiveReferences;
+    ghost->uses[slot]++;
+    ghost->referenced[slot] = chances;
+    return hit;
+}
+
+/*
+ * Hands replacement to the candidate with the most hits in the window when it leads the
+ * active policy by the margin. A full window must pass between switches, so that the
+ * comparison is never over a window the last switch was decided on.
+ */
+void AdaptiveMaybeSwitch() {
+    if (adaptiveReferences - lastSwitch < adaptiveWindow || Policy_GetPolicy() == POLICY_OPT) {
+        return;
+    }
+    int active = Policy_GetPolicy();
+    int best = active;
+    for (int policy = 0; policy < POLICY_COUNT; policy++) {
+        if ((adaptivePolicies & (1 << policy)) && windowHits[policy] > windowHits[best]) {
+            best = policy;
+        }
+    }
+    if (best == active || (long)(windowHits[best] - windowHits[active]) * 100 < (long)adaptiveMargin * adaptiveWindow) {
+        return;
+    }
+    printf("Switched replacement policy from %s to %s: %d against %d hits in the last %d references.\n",
+           Policy_Name(active), Policy_Name(best), windowHits[best], windowHits[active], adaptiveWindow);
+    Policy_SetPolicy(best);
+    policySwitches++;
+    lastSwitch = adaptiveReferences;
+}
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Reads adaptive replacement settings from a comma separated key=value list:
+ *   window=references margin=percent policies=name+name+...
+ * Returns FALSE (after printing why) if they are invalid.
+ */
+int Adaptive_Parse(const char* spec, AdaptiveSpec* out) {
+    out->enabled = TRUE;
+    out->window = 100;
+    out->margin = 10;
+    out->policies = (1 << POLICY_ONLINE) - 1;
+
+    char* copy = strdup(spec);
+    int ok = TRUE;
+    char* save;
+    for (char* item = strtok_r(copy, ",", &save); item != NULL && ok; item = strtok_r(NULL, ",", &save)) {
+        char* value = strchr(item, '=');
+        if (value == NULL) {
+            ok = FALSE;
+            break;
+        }
+        *value++ = '\0';
+        if (strcmp(item, "window") == 0) {
+            out->window = atoi(value);
+        } else if (strcmp(item, "margin") == 0) {
+            out->margin = atoi(value);
+        } else if (strcmp(item, "policies") == 0) {
+            out->policies = 0;
+            for (char* name = strtok(value, "+"); name != NULL && ok; name = strtok(NULL, "+")) {
+                int policy = Policy_FromName(name);
+                ok = (policy != -1 && policy < POLICY_ONLINE);
+                out->policies |= (policy != -1) ? 1 << policy : 0;
+            }
+        } else {
+            ok = FALSE;
+        }
+    }
+    free(copy);
+
+    if (!ok || out->window < 1 || out->margin < 0 || out->margin > 100 || out->policies == 0) {
+        printf("Invalid adaptive replacement '%s'. Use key=value pairs among window (references), " \
+               "margin (percent of the window) and policies (rr, clock, lru and lfu joined by +).\n", spec);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Starts following the candidates of a spec, and the active policy, from empty ghost caches.
+ * Under the optimal policy they are only compared against it, never switched to.
+ */
+void Adaptive_Init(const AdaptiveSpec* spec) {
+    adaptiveEnabled = spec->enabled;
+    adaptiveWindow = spec->enabled ? spec->window : 0;
+    adaptiveMargin = spec->margin;
+    adaptivePolicies = spec->enabled ? spec->policies | (1 << Policy_GetPolicy()) : 0;
+    for (int policy = 0; policy < POLICY_COUNT; policy++) {
+        GhostReset(&ghosts[policy]);
+    }
+    free(windowMasks);
+    windowMasks = calloc(adaptiveWindow > 0 ? adaptiveWindow : 1, 1);
+    memset(windowHits, 0, sizeof(windowHits));
+    memset(ghostMisses, 0, sizeof(ghostMisses));
+    adaptiveReferences = lastSwitch = policySwitches = 0;
+}
+
+int Adaptive_Enabled() {
+    return adaptiveEnabled;
+}
+
+/*
+ * Replays a load or store to a page, or with vpn FRAME_VPN_PAGETABLE a walk of a page
+ * table, on every candidate, and switches policy if one does better. Page tables compete
+ * for frames with pages, and get the extra clock chances they get in memory.
+ */
+void Adaptive_PageAccessed(int pid, int vpn) {
+    if (!adaptiveEnabled) {
+        return;
+    }
+    int key = GhostKey(pid, vpn);
+    int chances = (vpn == FRAME_VPN_PAGETABLE) ? 1 + POLICY_PT_BOOST : 1;
+    int mask = 0;
+    for (int policy = 0; policy < POLICY_COUNT; policy++) {
+        if (!(adaptivePolicies & (1 << policy))) {
+            continue;
+        }
+        if (GhostAccess(&ghosts[policy], policy, key, chances)) {
+            mask |= 1 << policy;
+        } else {
+            ghostMisses[policy]++;
+        }
+    }
+    int pos = adaptiveReferences % adaptiveWindow;
+    for (int policy = 0; policy < POLICY_COUNT; policy++) {
+        windowHits[policy] += ((mask >> policy) & 1) - ((windowMasks[pos] >> policy) & 1);
+    }
+    windowMasks[pos] = mask;
+    adaptiveReferences++;
+    AdaptiveMaybeSwitch();
+}
+
+void Adaptive_Report() {
+    if (!adaptiveEnabled) {
+        return;
+    }
+    if (Policy_GetPolicy() == POLICY_OPT) {
+        // Misses of the optimal ghost are the fewest faults any policy could take
+        printf("Replacement faults over %ld references: opt %ld", adaptiveReferences, ghostMisses[POLICY_OPT]);
+        for (int policy = 0; policy < POLICY_ONLINE; policy++) {
+            if (adaptivePolicies & (1 << policy)) {
+                printf(", %s %ld (%.2fx)", Policy_Name(policy), ghostMisses[policy],
+                       ghostMisses[POLICY_OPT] > 0 ? (double)ghostMisses[policy] / ghostMisses[POLICY_OPT] : 1.0);
+            }
+        }
+        printf("\n");
+        return;
+    }
+    long window = adaptiveReferences < adaptiveWindow ? adaptiveReferences : adaptiveWindow;
+    printf("Adaptive replacement: policy %s, %ld switches; hits in the last %ld references:",
+           Policy_Name(Policy_GetPolicy()), policySwitches, window);
+    for (int policy = 0; policy < POLICY_COUNT; policy++) {
+        if (adaptivePolicies & (1 << policy)) {
+            printf(" %s %d", Policy_Name(policy), windowHits[policy]);
+        }
+    }
+    printf("\n");
+}
+
+/* Saves the settings, the ghost caches, the window and the misses. */
+void Adaptive_Checkpoint(FILE* file) {
+    int settings[] = { adaptiveEnabled, adaptiveWindow, adaptiveMargin, adaptivePolicies };
+    long counters[] = { adaptiveReferences, lastSwitch, policySwitches };
+    Checkpoint_Write(file, settings, sizeof(settings));
+    Checkpoint_Write(file, counters, sizeof(counters));
+    Checkpoint_Write(file, ghosts, sizeof(ghosts));
+    Checkpoint_Write(file, windowHits, sizeof(windowHits));
+    Checkpoint_Write(file, ghostMisses, sizeof(ghostMisses));
+    Checkpoint_Write(file, windowMasks, adaptiveWindow);
+}
+
+/* Restores what Adaptive_Checkpoint saved, with the settings it was taken with. */
+int Adaptive_Restore(CheckpointReader* reader) {
+    int settings[4];
+    long counters[3];
+    if (!Checkpoint_ReadInto(reader, settings, sizeof(settings)) || settings[1] < 0) {
+        return FALSE;
+    }
+    AdaptiveSpec spec = { settings[0], settings[1], settings[2], settings[3] };
+    Adaptive_Init(&spec);
+    adaptivePolicies = settings[3];
+    if (!Checkpoint_ReadInto(reader, counters, sizeof(counters))
+        || !Checkpoint_ReadInto(reader, ghosts, sizeof(ghosts))
+        || !Checkpoint_ReadInto(reader, windowHits, sizeof(windowHits))
+        || !Checkpoint_ReadInto(reader, ghostMisses, sizeof(ghostMisses))
+        || !Checkpoint_ReadInto(reader, windowMasks, adaptiveWindow)) {
+        return FALSE;
+    }
+    adaptiveReferences = counters[0];
+    lastSwitch = counters[1];
+    policySwitches = counters[2];
+    return TRUE;
+}
@@ -0,0 +1,28 @@
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include <stdio.h>
+
+#include "checkpoint.h"
+
+/*
+ * Public Interface:
+ */
+
+/* Candidate policies and switching thresholds, from an --adaptive key=value list. */
+typedef struct {
+    int enabled;
+    int window;      // References over which the candidates' hits are compared
+    int margin;      // Percent of the window another candidate must lead by to take over
+    int policies;    // Candidates, a bit per POLICY_* id
+} AdaptiveSpec;
+
+int Adaptive_Parse(const char* spec, AdaptiveSpec* out);
+void Adaptive_Init(const AdaptiveSpec* spec);
+int Adaptive_Enabled();
+void Adaptive_PageAccessed(int pid, int vpn);
+void Adaptive_Report();
+void Adaptive_Checkpoint(FILE* file);
+int Adaptive_Restore(CheckpointReader* reader);
+
+#endif // ADAPTIVE_H
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+#include "mmu.h"
+
+/* Private Internals: */
+
+// Allocations are aligned for any metadata type (and the vector page kernels)
+#define ARENA_ALIGN 16
+
+// Slabs start with a header holding the link to the next slab
+#define POOL_SLAB_HEADER ARENA_ALIGN
+
+int arenaHugePages = FALSE;
+
+// Chunk being carved: bytes from arenaNext up to arenaEnd are free
+char* arenaNext = NULL;
+char* arenaEnd = NULL;
+
+long arenaChunks = 0;      // System allocations (mmap calls)
+long arenaBytes = 0;
+long poolAllocations = 0;
+long poolSlabs = 0;        // Carved from the arena; no new slabs means no new memory
+
+// Calls into the C allocator once setup is done. The link wraps malloc, calloc, realloc
+// and strdup (see the Makefile), so every call the simulator makes passes through here.
+int arenaSetupDone = FALSE;
+long mallocCalls = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* block, size_t size);
+char* __real_strdup(const char* string);
+
+size_t ArenaRound(size_t size, size_t unit) {
+    return (size + unit - 1) / unit * unit;
+}
+
+/*
+ * Maps a chunk from the system, backed by huge pages if they were asked for: explicit ones
+ * if the system has some reserved, transparent ones otherwise.
+ */
+char* ArenaMapChunk(size_t size) {
+    void* chunk = MAP_FAILED;
+    if (arenaHugePages) {
+        chunk = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (chunk == MAP_FAILED) {
+        chunk = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (chunk != MAP_FAILED && arenaHugePages) {
+            madvise(chunk, size, MADV_HUGEPAGE);
+        }
+    }
+    if (chunk == MAP_FAILED) {
+        return NULL;
+    }
+    arenaChunks++;
+    arenaBytes += size;
+    return chunk;
+}
+
+void ArenaCountMalloc() {
+    if (arenaSetupDone) {
+        mallocCalls++;
+    }
+}
+
+void* __wrap_malloc(size_t size) {
+    ArenaCountMalloc();
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    ArenaCountMalloc();
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* block, size_t size) {
+    ArenaCountMalloc();
+    return __real_realloc(block, size);
+}
+
+char* __wrap_strdup(const char* string) {
+    ArenaCountMalloc();
+    return __real_strdup(string);
+}
+
+/*
+ * Public Interface:
+ */
+
+/* Backs chunks mapped from now on with huge pages. */
+void Arena_Configure(int hugePages) {
+    arenaHugePages = hugePages;
+}
+
+/*
+ * Allocates zeroed memory that lives for the rest of the run. Memory is only reused
+ * through pools, so the arena is for tables and for the slabs of pools.
+ * Returns NULL if the system is out of memory.
+ */
+void* Arena_Alloc(size_t size) {
+    size = ArenaRound(size, ARENA_ALIGN);
+    if (arenaNext == NULL || (size_t)(arenaEnd - arenaNext) < size) {
+        size_t chunkSize = ArenaRound(size, ARENA_CHUNK_SIZE);
+        char* chunk = ArenaMapChunk(chunkSize);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        arenaNext = chunk;
+        arenaEnd = chunk + chunkSize;
+    }
+    void* block = arenaNext;
+    arenaNext += size;
+    return block;
+}
+
+void Pool_Init(Pool* pool, size_t objectSize) {
+    pool->objectSize = ArenaRound(objectSize < sizeof(void*) ? sizeof(void*) : objectSize, ARENA_ALIGN);
+    pool->freeList = NULL;
+    pool->slabs = NULL;
+}
+
+/* Takes a zeroed object from the pool, carving a new slab when none is free. */
+void* Pool_Alloc(Pool* pool) {
+    poolAllocations++;
+    if (pool->freeList != NULL) {
+        void* object = pool->freeList;
+        pool->freeList = *(void**)object;
+        memset(object, 0, pool->objectSize);
+        return object;
+    }
+    char* slab = Arena_Alloc(POOL_SLAB_HEADER + POOL_SLAB_OBJECTS * pool->objectSize);
+    if (slab == NULL) {
+        return NULL;
+    }
+    *(void**)slab = pool->slabs;
+    pool->slabs = slab;
+    poolSlabs++;
+    char* objects = slab + POOL_SLAB_HEADER;
+    for (int i = POOL_SLAB_OBJECTS - 1; i >= 1; i--) {
+        Pool_Free(pool, objects + i * pool->objectSize);
+    }
+    return objects; // fresh from the arena, already zeroed
+}
+
+void Pool_Free(Pool* pool, void* object) {
+    *(void**)object = pool->freeList;
+    pool->freeList = object;
+}
+
+/* Frees every object of the pool at once, e.g. when the processes are torn down. */
+void Pool_Reset(Pool* pool) {
+    pool->freeList = NULL;
+    for (char* slab = pool->slabs; slab != NULL; slab = *(char**)slab) {
+        char* objects = slab + POOL_SLAB_HEADER;
+        for (int i = POOL_SLAB_OBJECTS - 1; i >= 0; i--) {
+            Pool_Free(pool, objects + i * pool->objectSize);
+        }
+    }
+}
+
+/* Marks the end of setup: from here on the run should allocate only from pools and the arena. */
+void Arena_SetupDone() {
+    arenaSetupDone = TRUE;
+}
+
+void Arena_Report() {
+    printf("Allocations: pool objects %ld, pool slabs %ld, arena chunks %ld (%ld KiB) from the system,"
+           " malloc calls after setup %ld\n", poolAllocations, poolSlabs, arenaChunks, arenaBytes / 1024,
+           mallocCalls);
+}
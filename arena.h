@@ -0,0 +1,35 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Public Interface:
+ */
+
+// The arena maps memory from the system in chunks of (a multiple of) one huge page
+#define ARENA_CHUNK_SIZE (2 * 1024 * 1024)
+
+// Objects a pool carves out of the arena at a time
+#define POOL_SLAB_OBJECTS 64
+
+/*
+ * A typed pool of fixed size objects. Freed objects are kept for reuse, and resetting
+ * the pool frees all of its objects at once. Its memory is never given back to the system.
+ */
+typedef struct {
+    size_t objectSize;
+    void* freeList;   // Free objects, chained through their first word
+    void* slabs;      // Every slab carved so far, chained through their first word
+} Pool;
+
+void Arena_Configure(int hugePages);
+void* Arena_Alloc(size_t size);
+void Pool_Init(Pool* pool, size_t objectSize);
+void* Pool_Alloc(Pool* pool);
+void Pool_Free(Pool* pool, void* object);
+void Pool_Reset(Pool* pool);
+void Arena_SetupDone();
+void Arena_Report();
+
+#endif // ARENA_H
@@ -119,6 +119,19 @@ test_run () {
     return 0
 }
 
+# overwrite the first byte of a byte pattern (a grep -P regex) in a file, to damage
+# data a previous test saved
+corrupt_file () {
+    local file="$1"
+    local pattern="$2"
+    local offset=$(LC_ALL=C grep -obUaP "$pattern" "$file" | head -1 | cut -d: -f1)
+    if [ -z "$offset" ]; then
+        echo "Error: pattern not found in '$file'"
+        return 1
+    fi
+    printf '\xff' | dd of="$file" bs=1 seek="$offset" conv=notrunc status=none
+}
+
 #
 # Usage: 
 #      add test_run calls to run tests here like:
@@ -142,6 +155,39 @@ fi
 # Run tests -- use case specific -- renamed starting input and output files for test convention
 test_run "p3_1-RR" "./test/p3_1-testin.txt" "./test/p3_1-expected.txt" "./mmu" ""
 test_run "p3_2-RR" "./test/p3_2-testin.txt" "./test/p3_2-expected.txt" "./mmu" ""
+test_run "p3_3-RR" "./test/p3_3-testin.txt" "./test/p3_3-expected.txt" "./mmu" ""
+test_run "p3_4-RR-limit" "./test/p3_4-testin.txt" "./test/p3_4-expected.txt" "./mmu" "-m 1:2"
+test_run "p3_5-RR-zswap" "./test/p3_5-testin.txt" "./test/p3_5-expected.txt" "./mmu" "-z 16 -S"
+test_run "p3_6-RR-dedup" "./test/p3_6-testin.txt" "./test/p3_6-expected.txt" "./mmu" "-d -S"
+test_run "p3_7-RR-checkpoint" "./test/p3_7-testin.txt" "./test/p3_7-expected.txt" "./mmu" ""
+test_run "p3_8-RR-restore" "./test/p3_8-testin.txt" "./test/p3_8-expected.txt" "./mmu" "-S --restore p3_7-checkpoint.tmp"
+test_run "p3_9-RR-incremental" "./test/p3_9-testin.txt" "./test/p3_9-expected.txt" "./mmu" ""
+test_run "p3_10-RR-restore-chain" "./test/p3_10-testin.txt" "./test/p3_10-expected.txt" "./mmu" "-S -R p3_9-base.tmp -R p3_9-inc1.tmp --restore p3_9-inc2.tmp"
+test_run "p3_11-RR-eventlog" "./test/p3_3-testin.txt" "./test/p3_3-expected.txt" "./mmu" "-e p3_11-events.tmp"
+test_run "p3_12-trace" "p3_11-events.tmp" "./test/p3_12-expected.txt" "./mmutrace" "-b 5"
+test_run "p3_13-RR-gen" "./test/p3_13-testin.txt" "./test/p3_13-expected.txt" "./mmu" "--gen n=40,procs=3,pages=4,dist=phase,phase=10,writes=0.5,seed=5 -S"
+test_run "p3_14-RR-wide" "./test/p3_14-testin.txt" "./test/p3_14-expected.txt" "./mmu" ""
+test_run "p3_15-RR-numa" "./test/p3_15-testin.txt" "./test/p3_15-expected.txt" "./mmu" "-N nodes=2,migrate=3,distance=10/30/30/10 -P 1:preferred:0 -S"
+test_run "p3_16-RR-tier" "./test/p3_16-testin.txt" "./test/p3_16-expected.txt" "./mmu" "-T frames=2,promote=3,dram=100,far=400,swap=20000 -S"
+test_run "p3_17-RR-cost" "./test/p3_17-testin.txt" "./test/p3_17-expected.txt" "./mmu" "-d -T frames=1 -c tlb=1,walk=20,minor=500,major=10000,writeback=8000,zero=200 -S"
+test_run "p3_18-RR-adaptive" "./test/p3_18-testin.txt" "./test/p3_18-expected.txt" "./mmu" "-A window=8,margin=20 -S"
+test_run "p3_19-OPT" "./test/p3_19-testin.txt" "./test/p3_19-expected.txt" "./mmu" "-r opt -S"
+test_run "p3_20-RR-async" "./test/p3_20-testin.txt" "./test/p3_20-expected.txt" "./mmu" "-y window=4 -S"
+test_run "p3_21-RR-pagetable" "./test/p3_21-testin.txt" "./test/p3_21-expected.txt" "./mmu" "-S"
+test_run "p3_22-CLOCK" "./test/p3_21-testin.txt" "./test/p3_22-expected.txt" "./mmu" "-r clock -S"
+test_run "p3_23-RR-readahead" "./test/p3_23-testin.txt" "./test/p3_23-expected.txt" "./mmu" "-a 2 -S"
+test_run "p3_24-RR-readahead-eventlog" "./test/p3_23-testin.txt" "./test/p3_24-expected.txt" "./mmu" "-a 2 -e p3_24-events.tmp"
+test_run "p3_25-trace-readahead" "p3_24-events.tmp" "./test/p3_25-expected.txt" "./mmutrace" "-b 1"
+test_run "p3_26-RR-checkpoint-swapped" "./test/p3_26-testin.txt" "./test/p3_26-expected.txt" "./mmu" ""
+corrupt_file "p3_26-checkpoint.tmp" '\x88\x77\x66\x55\x44\x33\x22\x11' # the swapped out page 0 of PID 0
+test_run "p3_27-RR-restore-corrupt" "./test/p3_27-testin.txt" "./test/p3_27-expected.txt" "./mmu" "-S -R p3_26-checkpoint.tmp"
+test_run "p3_28-RR-async-limit" "./test/p3_28-testin.txt" "./test/p3_28-expected.txt" "./mmu" "-d -m *:2 -y window=4 -S"
+test_run "p3_29-RR-ksm" "./test/p3_29-testin.txt" "./test/p3_29-expected.txt" "./mmu" "-K 1:4 -S"
+test_run "p3_30-RR-kswapd" "./test/p3_21-testin.txt" "./test/p3_30-expected.txt" "./mmu" "-k 1:2 -S"
+test_run "p3_31-RR-working-set" "./test/p3_31-testin.txt" "./test/p3_31-expected.txt" "./mmu" "-d -s 2 -t 4 -w p3_31-series.tmp -S"
+test_run "p3_32-working-set-series" "p3_31-series.tmp" "./test/p3_32-expected.txt" "/bin/cat" ""
+test_run "p3_33-RR-async-fast-swap" "./test/p3_33-testin.txt" "./test/p3_33-expected.txt" "./mmu" "-y window=16 -c major=10,writeback=10 -S"
+test_run "p3_34-RR-async-slow-swap" "./test/p3_33-testin.txt" "./test/p3_34-expected.txt" "./mmu" "-y window=16 -c major=1000,writeback=1000 -S"
 # ...
 
 # sanity check -- another copy of the very first input and output files
@@ -0,0 +1,62 @@
+#include "bitmap.h"
+
+/* Private Internals: */
+
+/* Bits from..63 of the word holding bit from. */
+uint64_t BitmapFromMask(int from) {
+    return ~0ull << (from % 64);
+}
+
+/* Bits 0..to-1 of the word holding bit to-1. */
+uint64_t BitmapToMask(int to) {
+    return (to % 64 == 0) ? ~0ull : (1ull << (to % 64)) - 1;
+}
+
+/* First set bit of (map ^ invert) in [from, to), or -1. */
+int BitmapFind(const uint64_t* map, uint64_t invert, int from, int to) {
+    if (from >= to) {
+        return -1;
+    }
+    int word = from / 64;
+    int last = (to - 1) / 64;
+    uint64_t bits = (map[word] ^ invert) & BitmapFromMask(from);
+    while (bits == 0) {
+        if (++word > last) {
+            return -1;
+        }
+        bits = map[word] ^ invert;
+    }
+    int bit = word * 64 + __builtin_ctzll(bits);
+    return bit < to ? bit : -1;
+}
+
+/*
+ * Public Interface:
+ */
+
+/* First set bit in [from, to), or -1 if there is none. */
+int Bitmap_FindNextSet(const uint64_t* map, int from, int to) {
+    return BitmapFind(map, 0, from, to);
+}
+
+/* First clear bit in [from, to), or -1 if there is none. */
+int Bitmap_FindNextZero(const uint64_t* map, int from, int to) {
+    return BitmapFind(map, ~0ull, from, to);
+}
+
+/* Number of set bits in [from, to). */
+int Bitmap_Count(const uint64_t* map, int from, int to) {
+    if (from >= to) {
+        return 0;
+    }
+    int first = from / 64, last = (to - 1) / 64;
+    if (first == last) {
+        return __builtin_popcountll(map[first] & BitmapFromMask(from) & BitmapToMask(to));
+    }
+    int count = __builtin_popcountll(map[first] & BitmapFromMask(from))
+              + __builtin_popcountll(map[last] & BitmapToMask(to));
+    for (int word = first + 1; word < last; word++) {
+        count += __builtin_popcountll(map[word]);
+    }
+    return count;
+}
@@ -0,0 +1,25 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <stdint.h>
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Packed bit arrays, one bit per frame (or slot), 64 to a word. Searches and counts go a
+ * word at a time, so runs of frames that do not match cost one load per 64 of them.
+ */
+
+#define BITMAP_WORDS(bits) (((bits) + 63) / 64)
+
+#define BITMAP_TEST(map, i) (((map)[(i) / 64] >> ((i) % 64)) & 1)
+#define BITMAP_SET(map, i) ((map)[(i) / 64] |= 1ull << ((i) % 64))
+#define BITMAP_CLEAR(map, i) ((map)[(i) / 64] &= ~(1ull << ((i) % 64)))
+
+int Bitmap_FindNextSet(const uint64_t* map, int from, int to);
+int Bitmap_FindNextZero(const uint64_t* map, int from, int to);
+int Bitmap_Count(const uint64_t* map, int from, int to);
+
+#endif // BITMAP_H
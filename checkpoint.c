@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "checkpoint.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "pagetable.h"
+#include "policy.h"
+#include "process.h"
+#include "stats.h"
+#include "zswap.h"
+#include "tier.h"
+#include "cost.h"
+#include "adaptive.h"
+
+/* Private Internals: */
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t pageSize;
+    uint32_t physicalSize;
+    uint32_t virtualSize;
+    uint32_t numFrames;
+    uint32_t numSwapSlots;
+    uint32_t kind;          // CHECKPOINT_FULL or CHECKPOINT_INCREMENT
+    uint32_t sequence;      // Position in its chain, the full checkpoint is 0
+    uint64_t chainId;       // Chosen when the full checkpoint is taken
+} CheckpointHeader;
+
+// Chain the state was last saved to or restored from, and the position in it
+// (-1 if there is none, increments need a full checkpoint first)
+uint64_t chainId = 0;
+int chainSequence = -1;
+
+void CheckpointFillHeader(CheckpointHeader* header) {
+    memset(header, 0, sizeof(CheckpointHeader));
+    memcpy(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header->version = CHECKPOINT_VERSION;
+    header->pageSize = PAGE_SIZE;
+    header->physicalSize = PHYSICAL_SIZE;
+    header->virtualSize = VIRTUAL_SIZE;
+    header->numFrames = NUM_FRAMES;
+    header->numSwapSlots = NUM_SWAP_SLOTS;
+}
+
+/* Picks an id for a new chain, telling apart chains started by different runs. */
+uint64_t CheckpointNewChainId() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return ((uint64_t)now.tv_sec << 32) ^ (uint64_t)now.tv_nsec ^ ((uint64_t)getpid() << 16);
+}
+
+/*
+ * Writes a checkpoint of the given kind. Memory and swap go whole or as an increment,
+ * the other modules are small and always go whole.
+ */
+int CheckpointWrite(const char* path, int kind) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        return FALSE;
+    }
+    CheckpointHeader header;
+    CheckpointFillHeader(&header);
+    header.kind = kind;
+    header.chainId = (kind == CHECKPOINT_FULL) ? CheckpointNewChainId() : chainId;
+    header.sequence = (kind == CHECKPOINT_FULL) ? 0 : chainSequence + 1;
+    Checkpoint_Write(file, &header, sizeof(header));
+    if (kind == CHECKPOINT_FULL) {
+        Memsim_Checkpoint(file);
+    } else {
+        Memsim_CheckpointIncrement(file);
+    }
+    Policy_Checkpoint(file);
+    Proc_Checkpoint(file);
+    PT_Checkpoint(file);
+    Stats_Checkpoint(file);
+    Zswap_Checkpoint(file);
+    Tier_Checkpoint(file);
+    Cost_Checkpoint(file);
+    Adaptive_Checkpoint(file);
+    int ok = !ferror(file);
+    if (fclose(file) != 0 || !ok) {
+        return FALSE;
+    }
+    chainId = header.chainId;
+    chainSequence = header.sequence;
+    return TRUE;
+}
+
+
+/*
+ * Public Interface:
+ */
+
+/* Writes size bytes. An empty section may come from an array not allocated yet, so data can be NULL then. */
+void Checkpoint_Write(FILE* file, const void* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    fwrite(data, size, 1, file);
+}
+
+/* Pads the file with zeros up to a multiple of alignment. */
+void Checkpoint_WriteAlign(FILE* file, size_t alignment) {
+    long pos = ftell(file);
+    while (pos % alignment != 0) {
+        fputc(0, file);
+        pos++;
+    }
+}
+
+/* Returns the next size bytes in the mapped file, or NULL if the file ends before them. */
+const void* Checkpoint_Read(CheckpointReader* reader, size_t size) {
+    if (reader->size - reader->pos < size) {
+        reader->pos = reader->size;
+        return NULL;
+    }
+    const void* data = reader->data + reader->pos;
+    reader->pos += size;
+    return data;
+}
+
+/* Copies the next size bytes out of the file. Returns FALSE if the file ends before them. */
+int Checkpoint_ReadInto(CheckpointReader* reader, void* dst, size_t size) {
+    if (size == 0) {
+        return TRUE;
+    }
+    const void* data = Checkpoint_Read(reader, size);
+    if (data == NULL) {
+        return FALSE;
+    }
+    memcpy(dst, data, size);
+    return TRUE;
+}
+
+void Checkpoint_ReadAlign(CheckpointReader* reader, size_t alignment) {
+    size_t pos = (reader->pos + alignment - 1) / alignment * alignment;
+    reader->pos = (pos < reader->size) ? pos : reader->size;
+}
+
+/*
+ * Writes the whole simulator state to a file: memory and swap, replacement policy,
+ * processes and their page table registers, shared frames, statistics and the
+ * compressed swap pool. Starts a new chain. Must be called between instructions.
+ * Returns FALSE on error.
+ */
+int Checkpoint_Save(const char* path) {
+    return CheckpointWrite(path, CHECKPOINT_FULL);
+}
+
+/*
+ * Writes the state as an increment on the last checkpoint saved or restored, holding
+ * only the frames and swap slots written since. Its cost follows the writes made in
+ * between rather than the memory size. Returns FALSE on error or without a chain.
+ */
+int Checkpoint_SaveIncrement(const char* path) {
+    if (!Checkpoint_CanIncrement()) {
+        return FALSE;
+    }
+    return CheckpointWrite(path, CHECKPOINT_INCREMENT);
+}
+
+/* Whether a full checkpoint has been saved or restored for increments to build on. */
+int Checkpoint_CanIncrement() {
+    return chainSequence >= 0;
+}
+
+/*
+ * Replaces the simulator state with a checkpoint. A full checkpoint is mapped copy-on-write
+ * and physical memory is used in place from the mapping, so restoring costs a few page
+ * faults rather than a read of the whole image. An increment is applied on top of the
+ * state restored so far and must be the next one of its chain.
+ * Returns FALSE if the file is missing, truncated, out of chain order, or was written by
+ * another format version or memory geometry.
+ */
+int Checkpoint_Restore(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return FALSE;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(CheckpointHeader)) {
+        close(fd);
+        return FALSE;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return FALSE;
+    }
+
+    CheckpointReader reader = { data, st.st_size, 0 };
+    CheckpointHeader expected, header;
+    CheckpointFillHeader(&expected);
+    Checkpoint_ReadInto(&reader, &header, sizeof(header));
+    expected.kind = header.kind;
+    expected.sequence = header.sequence;
+    expected.chainId = header.chainId;
+    int inChain = (header.kind == CHECKPOINT_FULL && header.sequence == 0)
+               || (header.kind == CHECKPOINT_INCREMENT && chainSequence >= 0
+                   && header.chainId == chainId && (int)header.sequence == chainSequence + 1);
+    if (memcmp(&header, &expected, sizeof(header)) != 0 || !inChain) {
+        munmap(data, st.st_size);
+        return FALSE;
+    }
+    int ok;
+    if (header.kind == CHECKPOINT_FULL) {
+        ok = Memsim_Restore(&reader);
+    } else {
+        ok = Memsim_RestoreIncrement(&reader);
+    }
+    ok = ok && Policy_Restore(&reader) && Proc_Restore(&reader) && PT_Restore(&reader)
+            && Stats_Restore(&reader) && Zswap_Restore(&reader)
+            && Tier_Restore(&reader) && Cost_Restore(&reader) && Adaptive_Restore(&reader);
+    MMU_TLBFlushAll();
+    // The mapping of a full checkpoint stays for the rest of the run, physical memory
+    // lives in it. Increments are copied out.
+    if (header.kind == CHECKPOINT_INCREMENT) {
+        munmap(data, st.st_size);
+    }
+    if (ok) {
+        chainId = header.chainId;
+        chainSequence = header.sequence;
+    }
+    return ok;
+}
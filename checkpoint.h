@@ -0,0 +1,44 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * A checkpoint file is a header (magic, format version and the memory geometry it was
+ * taken with) followed by the state of each module, written and read back in the same
+ * order by the module's own _Checkpoint / _Restore functions.
+ *
+ * A full checkpoint starts a chain. Each incremental checkpoint after it only holds the
+ * memory and swap written since the previous checkpoint of the chain, so restoring one
+ * means restoring the full checkpoint and then every increment in order.
+ */
+#define CHECKPOINT_MAGIC "MMUCKPT"
+#define CHECKPOINT_VERSION 8
+
+// Checkpoint kinds
+#define CHECKPOINT_FULL 0
+#define CHECKPOINT_INCREMENT 1
+
+/* Cursor over a mapped checkpoint file. */
+typedef struct {
+    const char* data;
+    size_t size;
+    size_t pos;
+} CheckpointReader;
+
+void Checkpoint_Write(FILE* file, const void* data, size_t size);
+void Checkpoint_WriteAlign(FILE* file, size_t alignment);
+const void* Checkpoint_Read(CheckpointReader* reader, size_t size);
+int Checkpoint_ReadInto(CheckpointReader* reader, void* dst, size_t size);
+void Checkpoint_ReadAlign(CheckpointReader* reader, size_t alignment);
+int Checkpoint_Save(const char* path);
+int Checkpoint_SaveIncrement(const char* path);
+int Checkpoint_CanIncrement();
+int Checkpoint_Restore(const char* path);
+
+#endif // CHECKPOINT_H
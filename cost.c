@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cost.h"
+#include "mmu.h"
+#include "pagetable.h"
+#include "process.h"
+#include "checkpoint.h"
+
+/* Private Internals: */
+
+const char* costNames[COST_EVENTS] = { "tlb", "walk", "minor", "major", "writeback", "zero" };
+
+int costEnabled = FALSE;
+int costCycles[COST_EVENTS];
+
+// Process the current instruction runs for, or -1 between instructions (kswapd, KSM)
+int costPid = -1;
+
+long costEvents[COST_EVENTS];
+long totalCycles = 0;        // Including processes that have exited
+long backgroundCycles = 0;
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Reads cycles per event from a comma separated key=value list among tlb, walk (per page
+ * table level), minor, major, writeback and zero. "default" keeps every default.
+ * Returns FALSE (after printing why) if it is invalid.
+ */
+int Cost_Parse(const char* spec, CostSpec* out) {
+    int defaults[COST_EVENTS] = { 1, 30, 1000, 50000, 50000, 500 };
+    out->enabled = TRUE;
+    memcpy(out->cycles, defaults, sizeof(defaults));
+
+    char* copy = strdup(spec);
+    int ok = TRUE;
+    for (char* item = strtok(copy, ","); item != NULL && ok; item = strtok(NULL, ",")) {
+        if (strcmp(item, "default") == 0) {
+            continue;
+        }
+        char* value = strchr(item, '=');
+        ok = FALSE;
+        if (value == NULL) {
+            break;
+        }
+        *value++ = '\0';
+        for (int event = 0; event < COST_EVENTS; event++) {
+            if (strcmp(item, costNames[event]) == 0) {
+                out->cycles[event] = atoi(value);
+                ok = out->cycles[event] >= 0;
+            }
+        }
+    }
+    free(copy);
+
+    if (!ok) {
+        printf("Invalid cost model '%s'. Use default, or key=cycles pairs among tlb, walk, " \
+               "minor, major, writeback and zero.\n", spec);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Sets the cycles charged per event. A spec that is not enabled charges nothing. */
+void Cost_Init(const CostSpec* spec) {
+    costEnabled = spec->enabled;
+    memcpy(costCycles, spec->cycles, sizeof(costCycles));
+    costPid = -1;
+    memset(costEvents, 0, sizeof(costEvents));
+    totalCycles = backgroundCycles = 0;
+}
+
+int Cost_Enabled() {
+    return costEnabled;
+}
+
+/* Charges the events that follow to a process, or to the background with -1. */
+void Cost_SetProcess(int pid) {
+    costPid = pid;
+}
+
+/* Adds the modeled cycles of one event to the current process. */
+void Cost_Charge(int event) {
+    if (!costEnabled) {
+        return;
+    }
+    long cycles = Cost_EventCycles(event);
+    costEvents[event]++;
+    totalCycles += cycles;
+    Process* proc = (costPid == -1) ? NULL : Proc_Lookup(costPid);
+    if (proc == NULL) {
+        backgroundCycles += cycles;
+        return;
+    }
+    proc->stats.cycles += cycles;
+    if (event == COST_TLB_HIT || event == COST_WALK) {
+        proc->stats.translations++;
+    }
+}
+
+/* Cycles one event is charged, a whole walk for COST_WALK. */
+long Cost_EventCycles(int event) {
+    return (long)costCycles[event] * (event == COST_WALK ? PT_LEVELS : 1);
+}
+
+/* Number of events of a kind charged so far. */
+long Cost_Events(int event) {
+    return costEvents[event];
+}
+
+/* Cycles charged so far, to every process and the background. */
+long Cost_Total() {
+    return totalCycles;
+}
+
+/* How many times slower than if every translation had hit the TLB, or 0 if nothing ran. */
+double Cost_Slowdown(long cycles, long translations) {
+    long ideal = translations * costCycles[COST_TLB_HIT];
+    return ideal > 0 ? (double)cycles / ideal : 0.0;
+}
+
+void Cost_Report() {
+    if (!costEnabled) {
+        return;
+    }
+    printf("Modeled time: %ld cycles (%ld background), slowdown %.2fx over all TLB hits\n",
+           totalCycles, backgroundCycles,
+           Cost_Slowdown(totalCycles, costEvents[COST_TLB_HIT] + costEvents[COST_WALK]));
+    printf("Events: TLB hits %ld, walks %ld, minor faults %ld, major faults %ld, " \
+           "write-backs %ld, zero fills %ld\n", costEvents[COST_TLB_HIT], costEvents[COST_WALK],
+           costEvents[COST_MINOR_FAULT], costEvents[COST_MAJOR_FAULT],
+           costEvents[COST_WRITEBACK], costEvents[COST_ZERO_FILL]);
+}
+
+/* Saves the event counters. Cycles per event come from the command line of each run. */
+void Cost_Checkpoint(FILE* file) {
+    Checkpoint_Write(file, costEvents, sizeof(costEvents));
+    Checkpoint_Write(file, &totalCycles, sizeof(totalCycles));
+    Checkpoint_Write(file, &backgroundCycles, sizeof(backgroundCycles));
+}
+
+int Cost_Restore(CheckpointReader* reader) {
+    return Checkpoint_ReadInto(reader, costEvents, sizeof(costEvents))
+        && Checkpoint_ReadInto(reader, &totalCycles, sizeof(totalCycles))
+        && Checkpoint_ReadInto(reader, &backgroundCycles, sizeof(backgroundCycles));
+}
@@ -0,0 +1,40 @@
+#ifndef COST_H
+#define COST_H
+
+#include <stdio.h>
+
+#include "checkpoint.h"
+
+/*
+ * Public Interface:
+ */
+
+// Events charged modeled time
+#define COST_TLB_HIT 0
+#define COST_WALK 1          // Per page table level, on a TLB miss
+#define COST_MINOR_FAULT 2   // Fault served without I/O: far memory, zswap, fill byte, copy-on-write
+#define COST_MAJOR_FAULT 3   // Swap-in read from the swap file
+#define COST_WRITEBACK 4     // Page written to the swap file
+#define COST_ZERO_FILL 5     // Fresh page (or page table) handed out zeroed
+#define COST_EVENTS 6
+
+/* Cycles charged per event, from a --cost key=value list. */
+typedef struct {
+    int enabled;
+    int cycles[COST_EVENTS];
+} CostSpec;
+
+int Cost_Parse(const char* spec, CostSpec* out);
+void Cost_Init(const CostSpec* spec);
+int Cost_Enabled();
+void Cost_SetProcess(int pid);
+void Cost_Charge(int event);
+long Cost_EventCycles(int event);
+long Cost_Events(int event);
+long Cost_Total();
+double Cost_Slowdown(long cycles, long translations);
+void Cost_Report();
+void Cost_Checkpoint(FILE* file);
+int Cost_Restore(CheckpointReader* reader);
+
+#endif // COST_H
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "eventlog.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "stats.h"
+
+/* Private Internals: */
+
+// Records waiting for the drain thread, a power of two
+#define EVENTLOG_RING_SIZE 16384
+
+// How long the drain thread sleeps when the ring is empty
+#define EVENTLOG_DRAIN_INTERVAL_NS 1000000
+
+// Records are only added while holding the mm lock, so there is one producer at a time
+// and one consumer, the drain thread. Each side advances only its own index, and the
+// release/acquire pairs on them hand records over without a lock.
+EventRecord ring[EVENTLOG_RING_SIZE];
+_Atomic uint64_t ringHead = 0;  // Next record to fill, advanced by the producer
+_Atomic uint64_t ringTail = 0;  // Next record to write out, advanced by the drain thread
+
+FILE* logFile = NULL;
+int logEnabled = FALSE;
+atomic_int drainRunning = FALSE;
+pthread_t drainThread;
+pthread_mutex_t drainWaitLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t drainWait = PTHREAD_COND_INITIALIZER;
+
+long eventsLogged = 0;
+long producerWaits = 0;  // Events that found the ring full and waited for the drain thread
+
+/* Writes out every record published so far, in at most two runs. Returns how many. */
+uint64_t EventLogDrain() {
+    uint64_t tail = atomic_load_explicit(&ringTail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ringHead, memory_order_acquire);
+    uint64_t drained = head - tail;
+    while (tail != head) {
+        uint64_t start = tail % EVENTLOG_RING_SIZE;
+        uint64_t count = head - tail;
+        if (count > EVENTLOG_RING_SIZE - start) {
+            count = EVENTLOG_RING_SIZE - start;
+        }
+        fwrite(&ring[start], sizeof(EventRecord), count, logFile);
+        tail += count;
+    }
+    atomic_store_explicit(&ringTail, tail, memory_order_release);
+    return drained;
+}
+
+/* Drains the ring whenever it has records, napping while it is empty. */
+void* EventLogDrainMain(void* unused) {
+    while (atomic_load(&drainRunning)) {
+        if (EventLogDrain() > 0) {
+            continue;
+        }
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += EVENTLOG_DRAIN_INTERVAL_NS;
+        if (until.tv_nsec >= 1000000000) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+        pthread_mutex_lock(&drainWaitLock);
+        pthread_cond_timedwait(&drainWait, &drainWaitLock, &until);
+        pthread_mutex_unlock(&drainWaitLock);
+    }
+    EventLogDrain();
+    return NULL;
+}
+
+/*
+ * Public Interface:
+ */
+
+/* Starts logging events to a file, written by a background thread. Returns FALSE on error. */
+int EventLog_Open(const char* path) {
+    logFile = fopen(path, "wb");
+    if (logFile == NULL) {
+        return FALSE;
+    }
+    EventLogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EVENTLOG_MAGIC, sizeof(EVENTLOG_MAGIC));
+    header.version = EVENTLOG_VERSION;
+    header.pageSize = PAGE_SIZE;
+    header.numFrames = NUM_FRAMES;
+    header.recordSize = sizeof(EventRecord);
+    fwrite(&header, sizeof(header), 1, logFile);
+
+    atomic_store(&ringHead, 0);
+    atomic_store(&ringTail, 0);
+    eventsLogged = 0;
+    producerWaits = 0;
+    atomic_store(&drainRunning, TRUE);
+    pthread_create(&drainThread, NULL, EventLogDrainMain, NULL);
+    logEnabled = TRUE;
+    return TRUE;
+}
+
+/*
+ * Appends an event stamped with the current instruction. Called holding the mm lock.
+ * Costs a few stores unless the ring is full, in which case it waits for the drain
+ * thread rather than drop the event.
+ */
+void EventLog_Record(int type, int pid, int vpn, int frame, int offset, int flags) {
+    if (!logEnabled) {
+        return;
+    }
+    uint64_t head = atomic_load_explicit(&ringHead, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ringTail, memory_order_acquire);
+    if (head - tail == EVENTLOG_RING_SIZE) {
+        producerWaits++;
+        pthread_cond_signal(&drainWait);
+        while (head - atomic_load_explicit(&ringTail, memory_order_acquire) == EVENTLOG_RING_SIZE) {
+            sched_yield();
+        }
+    }
+
+    EventRecord* record = &ring[head % EVENTLOG_RING_SIZE];
+    record->instruction = Stats_GetInstructionCount();
+    record->type = type;
+    record->flags = flags;
+    record->pid = pid;
+    record->vpn = vpn;
+    record->frame = frame;
+    record->offset = offset;
+    atomic_store_explicit(&ringHead, head + 1, memory_order_release);
+    eventsLogged++;
+
+    // Wake the drain thread early once the ring is half full
+    if (head + 1 - tail == EVENTLOG_RING_SIZE / 2) {
+        pthread_cond_signal(&drainWait);
+    }
+}
+
+void EventLog_Report() {
+    if (logFile == NULL) {
+        return;
+    }
+    printf("Event log: %ld events, %ld waits for the drain thread\n", eventsLogged, producerWaits);
+}
+
+/* Stops logging, writing out every event recorded. */
+void EventLog_Close() {
+    if (logFile == NULL) {
+        return;
+    }
+    logEnabled = FALSE;
+    atomic_store(&drainRunning, FALSE);
+    pthread_cond_signal(&drainWait);
+    pthread_join(drainThread, NULL);
+    fclose(logFile);
+    logFile = NULL;
+}
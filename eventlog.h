@@ -0,0 +1,51 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <stdint.h>
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * An event log file is a header followed by fixed size records, in the order the events
+ * happened. Records only hold what the simulator did, so the same trace and options
+ * always give the same log (without the background threads, whose timing varies).
+ */
+#define EVENTLOG_MAGIC "MMUEVTS"
+#define EVENTLOG_VERSION 1
+
+// Event types
+#define EVENT_TLB_MISS 1   // A translation was not cached and the page table was walked
+#define EVENT_FAULT 2      // An access found its page (or page table, vpn -1) swapped out
+#define EVENT_SWAP_IN 3    // A faulted page was brought back into frame from offset
+#define EVENT_EVICT 4      // The page in frame was swapped out to offset
+#define EVENT_PREFETCH 5   // Readahead brought a page into frame from offset
+
+// Event flags
+#define EVENT_FLAG_SAMEFILLED 0x01  // Swapped as a fill byte, offset is the byte times PAGE_SIZE
+
+typedef struct {
+    uint64_t instruction;  // Instructions completed before the event
+    uint8_t type;
+    uint8_t flags;
+    uint16_t pid;
+    int32_t vpn;           // Page involved, or -1 for a page table
+    int32_t frame;         // Frame involved, or -1
+    int32_t offset;        // Swap offset involved, or -1
+} EventRecord;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t pageSize;
+    uint32_t numFrames;
+    uint32_t recordSize;
+} EventLogHeader;
+
+int EventLog_Open(const char* path);
+void EventLog_Record(int type, int pid, int vpn, int frame, int offset, int flags);
+void EventLog_Report();
+void EventLog_Close();
+
+#endif // EVENTLOG_H
@@ -0,0 +1,267 @@
+/*
+ * Microbenchmarks for the frame metadata layout (make bench; ./frame_bench [frames]).
+ * Runs the scans the simulator does over its frames, on the array of structs it used to
+ * keep (one record per frame) and on the bitmaps and byte arrays it keeps now, checks
+ * both give the same answers, and reports the time per frame scanned at a frame count
+ * (default 1M) far beyond the simulated memory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bitmap.h"
+
+#define BENCH_ROUNDS 20
+
+// Every frame can hold at most this many chances (1 + POLICY_PT_BOOST)
+#define BENCH_MAX_CHANCES 3
+
+/* The per-frame record as it was before the state the policy sweeps was split out of it. */
+typedef struct {
+    int inUse;
+    int pid;
+    int vpn;
+    int referenced;
+    int pinned;
+    int prefetched;
+    int mapCount;
+    int remoteAccesses;
+} BenchFrame;
+
+int numBenchFrames;
+BenchFrame* aos;
+uint64_t* usedBits;
+uint64_t* pinnedBits;
+uint64_t* sharedBits;
+unsigned char* chances;
+
+double BenchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Fills both layouts alike: memory nearly full, a few frames pinned by the current
+ * instruction or shared, and most frames referenced since the hand last passed.
+ */
+void BenchFill(int freeOneIn) {
+    memset(usedBits, 0, BITMAP_WORDS(numBenchFrames) * 8);
+    memset(pinnedBits, 0, BITMAP_WORDS(numBenchFrames) * 8);
+    memset(sharedBits, 0, BITMAP_WORDS(numBenchFrames) * 8);
+    srand(1);
+    for (int pfn = 0; pfn < numBenchFrames; pfn++) {
+        BenchFrame* f = &aos[pfn];
+        memset(f, 0, sizeof(*f));
+        f->inUse = rand() % freeOneIn != 0;
+        f->pinned = f->inUse && rand() % 64 == 0;
+        f->mapCount = (f->inUse && rand() % 256 == 0) ? 2 : 0;
+        f->referenced = f->inUse ? (rand() % 100 < 95 ? 1 + rand() % BENCH_MAX_CHANCES : 0) : 0;
+        f->pid = rand() % 64;
+        f->vpn = rand() % 1024;
+        if (f->inUse) {
+            BITMAP_SET(usedBits, pfn);
+        }
+        if (f->pinned) {
+            BITMAP_SET(pinnedBits, pfn);
+        }
+        if (f->mapCount > 0) {
+            BITMAP_SET(sharedBits, pfn);
+        }
+        chances[pfn] = f->referenced;
+    }
+}
+
+/* Next free frame at or after from, as Memsim_AllocFrameOnNode used to look for it. */
+int AosNextFree(int from) {
+    for (int pfn = from; pfn < numBenchFrames; pfn++) {
+        if (!aos[pfn].inUse) {
+            return pfn;
+        }
+    }
+    return -1;
+}
+
+int AosNextEvictable(int from) {
+    for (int pfn = from; pfn < numBenchFrames; pfn++) {
+        if (aos[pfn].inUse && !aos[pfn].pinned && aos[pfn].mapCount == 0) {
+            return pfn;
+        }
+    }
+    return -1;
+}
+
+/* The bitmap scan of Memsim_NextEvictable. */
+int SoaNextEvictable(int from) {
+    int words = BITMAP_WORDS(numBenchFrames);
+    int word = from / 64;
+    if (from >= numBenchFrames) {
+        return -1;
+    }
+    uint64_t bits = (usedBits[word] & ~pinnedBits[word] & ~sharedBits[word]) & (~0ull << (from % 64));
+    while (bits == 0) {
+        if (++word == words) {
+            return -1;
+        }
+        bits = usedBits[word] & ~pinnedBits[word] & ~sharedBits[word];
+    }
+    return word * 64 + __builtin_ctzll(bits);
+}
+
+/* Clock victim selection over the records, spending the chances of the frames passed. */
+int AosClock(int* hand) {
+    for (int step = 0; step < numBenchFrames * (BENCH_MAX_CHANCES + 1); step++) {
+        int pfn = *hand;
+        *hand = (*hand + 1) % numBenchFrames;
+        BenchFrame* f = &aos[pfn];
+        if (!f->inUse || f->pinned || f->mapCount > 0) {
+            continue;
+        }
+        if (f->referenced > 0) {
+            f->referenced--;
+            continue;
+        }
+        return pfn;
+    }
+    return -1;
+}
+
+/* The same selection as the policy does it now, skipping ineligible frames by the word. */
+int SoaClock(int* hand) {
+    for (int step = 0; step < numBenchFrames * (BENCH_MAX_CHANCES + 1); step++) {
+        int pfn = SoaNextEvictable(*hand);
+        if (pfn == -1 && (pfn = SoaNextEvictable(0)) == -1) {
+            return -1;
+        }
+        *hand = (pfn + 1) % numBenchFrames;
+        if (chances[pfn] > 0) {
+            chances[pfn]--;
+            continue;
+        }
+        return pfn;
+    }
+    return -1;
+}
+
+void BenchReport(const char* op, double aosSeconds, double soaSeconds, long count, const char* unit) {
+    printf("  %-20s %8.2f ns/%-6s %8.2f ns/%-6s %6.1fx\n", op, aosSeconds * 1e9 / count, unit,
+           soaSeconds * 1e9 / count, unit, aosSeconds / soaSeconds);
+}
+
+int main(int argc, char* argv[]) {
+    numBenchFrames = (argc > 1) ? atoi(argv[1]) : 1 << 20;
+    if (numBenchFrames < 64) {
+        printf("Use at least 64 frames.\n");
+        return 1;
+    }
+    aos = malloc((size_t)numBenchFrames * sizeof(BenchFrame));
+    usedBits = malloc(BITMAP_WORDS(numBenchFrames) * 8);
+    pinnedBits = malloc(BITMAP_WORDS(numBenchFrames) * 8);
+    sharedBits = malloc(BITMAP_WORDS(numBenchFrames) * 8);
+    chances = malloc(numBenchFrames);
+    printf("%d frames: records of %d bytes per frame against bitmaps and a byte per frame\n",
+           numBenchFrames, (int)sizeof(BenchFrame));
+    printf("  %-20s %18s %18s %7s\n", "", "array of structs", "bitmaps", "speedup");
+
+    // Free frame search: every free frame of a memory with 1 in 4096 frames free
+    BenchFill(4096);
+    long found = 0, foundSoa = 0;
+    double t0 = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int pfn = AosNextFree(0); pfn != -1; pfn = AosNextFree(pfn + 1)) {
+            found += pfn;
+        }
+    }
+    double t1 = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int pfn = Bitmap_FindNextZero(usedBits, 0, numBenchFrames); pfn != -1;
+             pfn = Bitmap_FindNextZero(usedBits, pfn + 1, numBenchFrames)) {
+            foundSoa += pfn;
+        }
+    }
+    double t2 = BenchNow();
+    if (found != foundSoa) {
+        printf("Free frame search mismatch\n");
+        return 1;
+    }
+    BenchReport("find free frame", t1 - t0, t2 - t1, (long)numBenchFrames * BENCH_ROUNDS, "frame");
+
+    // Free frame count, as each NUMA node's is recounted after a restore
+    found = foundSoa = 0;
+    t0 = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int pfn = 0; pfn < numBenchFrames; pfn++) {
+            found += !aos[pfn].inUse;
+        }
+    }
+    t1 = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        foundSoa += numBenchFrames - Bitmap_Count(usedBits, 0, numBenchFrames);
+    }
+    t2 = BenchNow();
+    if (found != foundSoa) {
+        printf("Free frame count mismatch\n");
+        return 1;
+    }
+    BenchReport("count free frames", t1 - t0, t2 - t1, (long)numBenchFrames * BENCH_ROUNDS, "frame");
+
+    // Round robin: every frame the policy may evict, with a quarter of memory free
+    BenchFill(4);
+    found = foundSoa = 0;
+    t0 = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int pfn = AosNextEvictable(0); pfn != -1; pfn = AosNextEvictable(pfn + 1)) {
+            found += pfn;
+        }
+    }
+    t1 = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int pfn = SoaNextEvictable(0); pfn != -1; pfn = SoaNextEvictable(pfn + 1)) {
+            foundSoa += pfn;
+        }
+    }
+    t2 = BenchNow();
+    if (found != foundSoa) {
+        printf("Evictable frame scan mismatch\n");
+        return 1;
+    }
+    BenchReport("next evictable", t1 - t0, t2 - t1, (long)numBenchFrames * BENCH_ROUNDS, "frame");
+
+    // Clock: pick victims until the hand has gone round several times
+    BenchFill(4);
+    int hand = 0, handSoa = 0, victims = numBenchFrames / 8;
+    found = foundSoa = 0;
+    t0 = BenchNow();
+    for (int i = 0; i < victims; i++) {
+        found += AosClock(&hand);
+    }
+    t1 = BenchNow();
+    for (int i = 0; i < victims; i++) {
+        foundSoa += SoaClock(&handSoa);
+    }
+    t2 = BenchNow();
+    if (found != foundSoa || hand != handSoa) {
+        printf("Clock victim mismatch\n");
+        return 1;
+    }
+    BenchReport("clock victim", t1 - t0, t2 - t1, (long)victims, "pick");
+
+    // Releasing the pins at the end of an instruction
+    t0 = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int pfn = 0; pfn < numBenchFrames; pfn++) {
+            aos[pfn].pinned = 0;
+        }
+        aos[r].pinned = 1;
+    }
+    t1 = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        memset(pinnedBits, 0, BITMAP_WORDS(numBenchFrames) * 8);
+        BITMAP_SET(pinnedBits, r);
+    }
+    t2 = BenchNow();
+    BenchReport("unpin all", t1 - t0, t2 - t1, (long)numBenchFrames * BENCH_ROUNDS, "frame");
+    return 0;
+}
@@ -1,17 +1,26 @@
 #include <stdio.h>  
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "input.h"
 #include "memsim.h"
 #include "instruction.h"
 #include "mmu.h"
 #include "pagetable.h"
-#include "instruction.h"
+#include "process.h"
+#include "stats.h"
+#include "checkpoint.h"
+#include "numa.h"
+#include "cost.h"
+#include "opt.h"
 
 
 /* Private Internals */
 
+// The line being executed, read into the same buffer every time
+char inputLine[MAX_GETLINE_CHARS];
+
 int InputStrToInt(char* inStr, int* outInt) {
 	int bytesCast;
 	bytesCast = sscanf(inStr, "%d", outInt);
@@ -23,7 +32,50 @@ int InputStrToInt(char* inStr, int* outInt) {
 	return TRUE;
 }
 
-void InputDispatchCommand(int pid, char* instruction_type, int virtual_address, int value) {
+/* Returns the width in bytes of a load8-load64 or store8-store64 instruction of a kind, or 0. */
+int InputAccessBytes(const char* instruction_type, const char* kind) {
+	size_t length = strlen(kind);
+	if (strncmp(instruction_type, kind, length) != 0) {
+		return 0;
+	}
+	const char* bits = instruction_type + length;
+	if (strcmp(bits, "8") == 0 || strcmp(bits, "16") == 0 || strcmp(bits, "32") == 0 || strcmp(bits, "64") == 0) {
+		return atoi(bits) / 8;
+	}
+	return 0;
+}
+
+/* Stores a value given as text, which must fit in the width of the store. */
+void InputStoreWide(int pid, char* instruction_type, int virtual_address, int bytes, char* value_string) {
+	char* end;
+	uint64_t max = (bytes == 8) ? UINT64_MAX : (1ull << (8 * bytes)) - 1;
+	uint64_t value = strtoull(value_string, &end, 10);
+	if (end == value_string || *end != '\0' || value_string[0] == '-' || value > max) {
+		printf("Invalid value for %s instruction. Value must be 0-%llu.\n", instruction_type,
+			   (unsigned long long)max);
+		return;
+	}
+	Instruction_StoreWide(pid, virtual_address, bytes, value);
+}
+
+/* Copies between two ranges of a process, given as destination,length. */
+void InputMemcpy(int pid, int virtual_address, char* value_string) {
+	int dst, length;
+	char extra;
+	if (sscanf(value_string, "%d,%d %c", &dst, &length, &extra) != 2) {
+		printf("Incorrectly formatted instruction.\n" \
+				  "Correct format is: process_id,memcpy,source_address,destination_address,length\n");
+		return;
+	}
+	if (dst < 0 || dst > VIRTUAL_SIZE-1) {
+		printf("Invalid Virtual Address.  Virtual Address must be in range 0-63.\n");
+		return;
+	}
+	Instruction_Memcpy(pid, virtual_address, dst, length);
+}
+
+void InputDispatchCommand(int pid, char* instruction_type, int virtual_address, int value, char* value_string) {
+	int bytes;
 	// dispatch to the appropriate instruction handler
 	if (strcmp(instruction_type, "map") == 0) {
 		Instruction_Map(pid, virtual_address, value);
@@ -36,12 +88,50 @@ void InputDispatchCommand(int pid, char* instruction_type, int virtual_address,
 		else{
 			Instruction_Load(pid, virtual_address);
 		}
+	} else if (strcmp(instruction_type, "create") == 0) {
+		Instruction_Create(pid);
+	} else if (strcmp(instruction_type, "exit") == 0) {
+		Instruction_Exit(pid);
+	} else if ((bytes = InputAccessBytes(instruction_type, "load")) > 0) {
+		Instruction_LoadWide(pid, virtual_address, bytes);
+	} else if ((bytes = InputAccessBytes(instruction_type, "store")) > 0) {
+		InputStoreWide(pid, instruction_type, virtual_address, bytes, value_string);
+	} else if (strcmp(instruction_type, "memcpy") == 0) {
+		InputMemcpy(pid, virtual_address, value_string);
 	} else{
-		printf("Invalid Instruction type. Valid instructions are map, store, and load.\n");
+		printf("Invalid Instruction type. Valid instructions are map, store, load, create, exit, " \
+			   "load8-load64, store8-store64, and memcpy.\n");
 	}
 }
 
-int InputParseAndValidateLine(char* line, int* pidOut, char** instructionTypeOut, int* VAOut, int* valOut) {
+/*
+ * Handles a "checkpoint [-i] <file>" line, which saves the simulator state between
+ * instructions. With -i only what changed since the previous checkpoint is saved.
+ */
+int InputCheckpoint(char* path) {
+    path[strcspn(path, "\r\n")] = '\0';
+    int incremental = (strncmp(path, "-i ", strlen("-i ")) == 0);
+    if (incremental) {
+        path += strlen("-i ");
+    }
+    if (path[0] == '\0') {
+        printf("Incorrectly formatted checkpoint. Use: checkpoint [-i] <file>\n");
+        return FALSE;
+    }
+    if (incremental && !Checkpoint_CanIncrement()) {
+        printf("Error: incremental checkpoint %s needs a full checkpoint first.\n", path);
+        return FALSE;
+    }
+    if (!(incremental ? Checkpoint_SaveIncrement(path) : Checkpoint_Save(path))) {
+        printf("Error: could not write checkpoint to %s.\n", path);
+        return FALSE;
+    }
+    printf("Saved checkpoint to %s.\n", path);
+    return TRUE;
+}
+
+int InputParseAndValidateLine(char* line, int* pidOut, char** instructionTypeOut, int* VAOut, int* valOut,
+                              char** valueStringOut) {
     //if there is input, process it
     char* pid_string;
     char* virtual_address_string;
@@ -52,13 +142,14 @@ int InputParseAndValidateLine(char* line, int* pidOut, char** instructionTypeOut
     *instructionTypeOut = strtok(NULL, ",");
     virtual_address_string = strtok(NULL, ",");
     value_string = strtok(NULL, "\n"); // This might be NULL if not provided in input
+    *valueStringOut = value_string;
 
     //convert string containing pid to an int
     if (!InputStrToInt(pid_string, pidOut)) {
         return FALSE;
     } else { // validate integer value of pid
-        if (*pidOut < 0 || *pidOut > NUM_PROCESSES-1) {
-            printf("Invalid Process Id.  Process Id must be in range 0-3.\n");
+        if (*pidOut < 0 || *pidOut > MAX_PID) {
+            printf("Invalid Process Id.  Process Id must be in range 0-%d.\n", MAX_PID);
             return FALSE;
         }
     }
@@ -74,12 +165,25 @@ int InputParseAndValidateLine(char* line, int* pidOut, char** instructionTypeOut
     }
 
     // Handle the "value" field properly
-   if (strcmp(*instructionTypeOut, "load") == 0) {
-    if (value_string == NULL || (strcmp(value_string, "NA") != 0 && strcmp(value_string, "0") != 0)) {
-        printf("Incorrectly formatted instruction.\nValue should be NA or 0 for the load instruction.\n");
-        return FALSE;
-    }
-    *valOut = -1; // Assign -1 when "NA" or "0" is provided
+    if (strcmp(*instructionTypeOut, "load") == 0) {
+        if (value_string == NULL || (strcmp(value_string, "NA") != 0 && strcmp(value_string, "0") != 0)) {
+            printf("Incorrectly formatted instruction.\nValue should be NA for the load instruction.\n");
+            return FALSE;
+        }
+        *valOut = -1; // Assign -1 when "NA" or "0" is provided
+    } else if (strcmp(*instructionTypeOut, "create") == 0 || strcmp(*instructionTypeOut, "exit") == 0
+               || InputAccessBytes(*instructionTypeOut, "load") > 0) {
+        if (value_string == NULL || strcmp(value_string, "NA") != 0) {
+            printf("Incorrectly formatted instruction.\nValue should be NA for the %s instruction.\n", *instructionTypeOut);
+            return FALSE;
+        }
+        *valOut = -1;
+    } else if (InputAccessBytes(*instructionTypeOut, "store") > 0 || strcmp(*instructionTypeOut, "memcpy") == 0) {
+        // Wider than an int, or more than one field: checked when the instruction runs
+        if (value_string == NULL) {
+            return InputStrToInt("", valOut);
+        }
+        *valOut = 0;
     } else {
         if (!InputStrToInt(value_string, valOut)) {
             return FALSE;
@@ -99,27 +203,98 @@ int Input_NextInstruction(char* line) {
 	char* instruction_type;
 	int virtual_address;
 	int value;
+	char* value_string;
+
+	if (strncmp(line, "checkpoint ", strlen("checkpoint ")) == 0) {
+		return InputCheckpoint(line + strlen("checkpoint "));
+	}
 
 	// load validated values into the instruction variables, or return and try again
-	if (!InputParseAndValidateLine(line, &pid, &instruction_type, &virtual_address, &value)) {
+	if (!InputParseAndValidateLine(line, &pid, &instruction_type, &virtual_address, &value, &value_string)) {
 		return FALSE;
 	} 
 
 	// dispatch the instruction to the appropriate handler
-	InputDispatchCommand(pid, instruction_type, virtual_address, value);
+	Cost_SetProcess(pid);
+	InputDispatchCommand(pid, instruction_type, virtual_address, value, value_string);
+	Input_InstructionDone(pid);
 	return TRUE; // successful instruction execution
 }
 
+/* Completes an instruction, however it was issued: read from input or generated. */
+void Input_InstructionDone(int pid) {
+	Memsim_UnpinAll(); // frames used by this instruction may be evicted again
+	Numa_InstructionDone();
+	Stats_InstructionDone(pid);
+	Cost_SetProcess(-1); // reclaim and merging between instructions run in the background
+}
+
+/* Adds the pages of [va, va + length) not listed yet. */
+int InputAddPages(int va, int length, int* vpns, int count) {
+	if (va < 0 || va >= VIRTUAL_SIZE || length < 1) {
+		return count;
+	}
+	int last = (va + length - 1 < VIRTUAL_SIZE) ? va + length - 1 : VIRTUAL_SIZE - 1;
+	for (int vpn = VPN(va); vpn <= VPN(last); vpn++) {
+		int listed = FALSE;
+		for (int i = 0; i < count; i++) {
+			listed |= (vpns[i] == vpn);
+		}
+		if (!listed) {
+			vpns[count++] = vpn;
+		}
+	}
+	return count;
+}
+
+/*
+ * Lists the pages a line will load, store, map or copy, without running it, into vpns
+ * (room for VPN(VIRTUAL_SIZE) pages) and sets pidOut to its process.
+ * Returns how many there are, or -1 if the line is not an instruction of a process
+ * (a checkpoint or a line without a valid process id).
+ */
+int Input_LinePages(const char* line, int* pidOut, int* vpns) {
+	int va, bytes, dst, length;
+	char type[16], value[64];
+	int fields = sscanf(line, "%d,%15[^,],%d,%63[^\n]", pidOut, type, &va, value);
+	if (fields < 2 || *pidOut < 0 || *pidOut > MAX_PID) {
+		return -1;
+	}
+	if (fields < 3) {
+		return 0;
+	}
+	if (strcmp(type, "map") == 0 || strcmp(type, "store") == 0 || strcmp(type, "load") == 0) {
+		return InputAddPages(va, 1, vpns, 0);
+	}
+	if ((bytes = InputAccessBytes(type, "load")) > 0 || (bytes = InputAccessBytes(type, "store")) > 0) {
+		return InputAddPages(va, bytes, vpns, 0);
+	}
+	if (strcmp(type, "memcpy") == 0 && fields == 4 && sscanf(value, "%d,%d", &dst, &length) == 2) {
+		return InputAddPages(dst, length, vpns, InputAddPages(va, length, vpns, 0));
+	}
+	return 0;
+}
+
 /*
- * Reads one line of input from stdin. 
- * ALLOCATES MEMORY FOR LINE. 
- * Each call ALLOCATES MAX_GELINE_CHARS bytes for line.
- * Remember to free.
- * Returns the number of characters read, or -1 if an error occurred.
+ * Reads one line of input from stdin into a buffer reused by every call, so reading
+ * allocates nothing. The line is only valid until the next call. Lines longer than
+ * MAX_GETLINE_CHARS - 2 characters are cut short and the rest is skipped.
+ * Returns the number of characters read, or -1 at end of input or on an error.
  */
 int Input_GetLine(char** line) {
 	printf("Instruction? ");
-	size_t len = MAX_GETLINE_CHARS;
-	*line = (char*)malloc(sizeof(char)*len);
-	return getline(line, &len, stdin);
+	*line = inputLine;
+	if (Opt_Enabled()) {
+		return Opt_NextLine(inputLine, MAX_GETLINE_CHARS);
+	}
+	if (fgets(inputLine, MAX_GETLINE_CHARS, stdin) == NULL) {
+		return -1;
+	}
+	int len = strlen(inputLine);
+	if (inputLine[len - 1] != '\n' && !feof(stdin)) {
+		int c;
+		while ((c = getchar()) != '\n' && c != EOF) {
+		}
+	}
+	return len;
 }
\ No newline at end of file
@@ -11,5 +11,7 @@
 
 int Input_GetLine(char** line);
 int Input_NextInstruction(char* line);
+void Input_InstructionDone(int pid);
+int Input_LinePages(const char* line, int* pidOut, int* vpns);
 
 #endif // INPUT_H
\ No newline at end of file
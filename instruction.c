@@ -4,110 +4,71 @@
 #include "memsim.h"
 #include "pagetable.h"
 #include "mmu.h"
-
-int Instruction_Map(int pid, int va, int value_in) {
-    int vpn = VPN(va);
-    PageTableEntry* pte = PT_GetPTE(pid, vpn);
-
-    if (pte != NULL) { // If page is already mapped
-        if (pte->rw_bit == 0 && value_in == 1) {
-            PT_UpdateWritePerm(pid, vpn, 1);
-            printf("Updating permissions for virtual page %d (frame %d)\n", vpn, pte->PFN);
-        } else {
-            printf("Error: virtual page %d is already mapped with rw_bit=%d\n", vpn, pte->rw_bit);
-        }
-        return 0;  
-    }
-
-    // Ensure page table exists
-    if (!PT_PageTableExists(pid)) {
-        int pt_frame = (pid == 0) ? 0 : Memsim_FirstFreePFN(); // Ensure frame 0 for PID 0
-        PT_PageTableCreate(pid, pt_frame);
-        printf("Put page table for PID %d into physical frame %d\n", pid, pt_frame);
-    }
-
-    int frame = Memsim_FirstFreePFN();
-    if (frame == -1) {
-        frame = PT_Evict(); // Evict if necessary
-    }
-
-    PT_SetPTE(pid, vpn, frame, 1, value_in, 1, 0);
-    printf("Mapped virtual address %d (page %d) into physical frame %d\n", va, vpn, frame);
+#include "process.h"
 
 /*
  * Searches the memory for a free page, and assigns it to the process's virtual address. If value is
  * 0, the page has read only permissions, and if it is 1, it has read/write permissions.
  * If the process does not already have a page table, one is assigned to it. If there are no more empty
- * pages, the mapping fails.
+ * pages, a page (possibly another process's page table) is evicted to make room.
+ * Mapping an already mapped page with different permissions updates its permissions.
  */
-
 int Instruction_Map(int pid, int va, int value_in) {
     int pa;
-    char* physmem = Memsim_GetPhysMem();
 
     if (value_in != 0 && value_in != 1) {
         printf("Invalid value for map instruction. Value must be 0 or 1.\n");
         return 1;
     }
-    if ((pa = PT_VPNtoPA(pid, VPN(va))) != -1) {
-        printf("Error: Virtual page already mapped into physical frame %d.\n", PFN(pa));
-        return 1;
-    }
-
-    // Ensure the first page table is in physical frame 0
-    if (!PT_PageTableExists(pid)) {
-        int pt_frame = (pid == 0) ? 0 : Memsim_FirstFreePFN();
-        if (pt_frame == -1) {
-            printf("Error: No available memory for page table.\n");
-            return 1;
+    // An existing mapping is looked up, not translated: a swapped-out page that cannot get a
+    // frame back is still mapped, and must not be mapped over.
+    PageTableEntry* pte = PT_GetPTE(pid, VPN(va));
+    if (pte != NULL) {
+        int present = pte->present;
+        int frame = pte->PFN;
+        if (pte->protection != value_in) {
+            if ((pa = PT_VPNtoPA(pid, VPN(va))) == -1) {
+                printf("Error: No available memory.\n");
+                return 1;
+            }
+            PT_UpdateWritePerm(pid, VPN(va), value_in);
+            printf("Updating permissions for virtual page %d (frame %d)\n", VPN(va), PFN(pa));
+            return 0;
         }
-        PT_PageTableCreate(pid, pt_frame);
-        
-        // Debug: Confirm page table creation
-        printf("Put page table for PID %d into physical frame %d\n", pid, pt_frame);
-    }
-
-    // Allocate a frame for the virtual page
-    pa = Memsim_FirstFreePFN();
-    if (pa == -1) {
-        pa = PT_Evict();
-        if (pa == -1) {
-            printf("Error: No available memory.\n");
-            return 1;
+        if (present) {
+            printf("Error: Virtual page already mapped into physical frame %d.\n", frame);
+        } else {
+            printf("Error: Virtual page already mapped (swapped out).\n");
         }
+        return 1;
     }
 
-    // Set the page table entry
-    PT_SetPTE(pid, VPN(va), PFN(pa), 1, value_in, 1, 0);
-    printf("Mapped virtual address %d (page %d) into physical frame %d.\n", va, VPN(va), PFN(pa));
+    int pfn = PT_Map(pid, VPN(va), value_in);
+    if (pfn == -1) {
+        printf("Error: No available memory.\n");
+        return 1;
+    }
+    printf("Mapped virtual address %d (page %d) into physical frame %d.\n", va, VPN(va), pfn);
 
     return 0;
 }
 
-
-int Instruction_Store(int pid, int va, int value_in) {
-    int vpn = VPN(va);
-    int offset = PAGE_OFFSET(va);
-    int pa = MMU_TranslateAddress(pid, vpn, offset);
-
-
+/*
+ * Translates the virtual address and writes the value to it, if the page is mapped writable.
+ */
 int Instruction_Store(int pid, int va, int value_in) {
-    int pa = MMU_TranslateAddress(pid, VPN(va), PAGE_OFFSET(va));
-
-    if (pa == -1) {
-        printf("Error: Virtual address %d is not mapped.\n", va);
+    if (value_in < 0 || value_in > 255) {
+        printf("Invalid value for store instruction. Value must be 0-255.\n");
         return 1;
     }
 
-
-    if (!PT_GetWritePerm(pid, vpn)) {  // If write permission is not allowed
-        printf("Error: writes are not allowed to this page\n");
+    int pa = MMU_TranslateForAccess(pid, va, MMU_ACCESS_WRITE);
+    if (pa == MMU_FAULT_NOT_MAPPED || pa == MMU_FAULT_PROTECTION) {
+        printf("Error: virtual address %d does not have write permissions.\n", va);
         return 1;
     }
-
-
-    if (!PT_PIDHasWritePerm(pid, VPN(va))) {
-        printf("Error: Virtual address %d does not have write permissions.\n", va);
+    if (pa < 0) {
+        printf("Error: No available memory.\n");
         return 1;
     }
 
@@ -116,36 +77,147 @@ int Instruction_Store(int pid, int va, int value_in) {
     return 0;
 }
 
+/*
+ * Translates the virtual address and prints the value stored there.
+ */
+int Instruction_Load(int pid, int va) {
+    int pa = MMU_TranslateForAccess(pid, va, MMU_ACCESS_READ);
 
+    // Ensure address is valid
+    if (pa < 0) {
+        printf("Error: The virtual address %d is not valid.\n", va);
+        return 1;
+    }
 
+    int value = Memsim_Load(pa);
+    printf("The value %d was found at virtual address %d.\n", value, va);
+    return 0;
+}
 
+/*
+ * Copies len bytes between a buffer and the virtual memory of a process, one page at a
+ * time: each page touched is translated once and copied in one piece. A store checks that
+ * every page is writable before changing any of them. Pins are dropped after each page,
+ * so an access spanning more pages than there are frames still completes.
+ * Prints the error and returns FALSE if an address cannot be accessed.
+ */
+int InstructionCopy(int pid, int va, char* buffer, int len, int write) {
+    if (va < 0 || len < 1 || va + len > VIRTUAL_SIZE) {
+        printf("Error: The virtual address range %d-%d is not valid.\n", va, va + len - 1);
+        return FALSE;
+    }
+    // A single page store is checked by its translation
+    if (write && VPN(va) != VPN(va + len - 1)) {
+        for (int vpn = VPN(va); vpn <= VPN(va + len - 1); vpn++) {
+            if (!PT_PIDHasWritePerm(pid, vpn)) {
+                int first = (vpn == VPN(va)) ? va : PAGE_START(vpn);
+                printf("Error: virtual address %d does not have write permissions.\n", first);
+                return FALSE;
+            }
+        }
+    }
 
-int Instruction_Load(int pid, int va) {
-    int vpn = VPN(va);
-    int offset = PAGE_OFFSET(va);
-    int pa = MMU_TranslateAddress(pid, vpn, offset);
+    for (int done = 0; done < len; ) {
+        int addr = va + done;
+        int chunk = PAGE_SIZE - PAGE_OFFSET(addr);
+        if (chunk > len - done) {
+            chunk = len - done;
+        }
+        int pa = MMU_TranslateForAccess(pid, addr, write ? MMU_ACCESS_WRITE : MMU_ACCESS_READ);
+        if (pa == MMU_FAULT_PROTECTION || (write && pa == MMU_FAULT_NOT_MAPPED)) {
+            printf("Error: virtual address %d does not have write permissions.\n", addr);
+            return FALSE;
+        } else if (pa == MMU_FAULT_NOT_PRESENT) {
+            printf("Error: No available memory.\n");
+            return FALSE;
+        } else if (pa < 0) {
+            printf("Error: The virtual address %d is not valid.\n", addr);
+            return FALSE;
+        }
+        if (write) {
+            Memsim_Write(pa, buffer + done, chunk);
+        } else {
+            Memsim_Read(pa, buffer + done, chunk);
+        }
+        Memsim_UnpinAll(); // the next page may need this frame
+        done += chunk;
+    }
+    return TRUE;
+}
 
-    if (pa == -1) { // If page is not in memory, swap it in
-        int evicted_frame = PT_Evict();
-        int swap_slot = Memsim_SwapOut(evicted_frame);
-        printf("Swapped frame %d to disk at swap slot %d\n", evicted_frame, swap_slot);
+/*
+ * Loads a little endian value of 1, 2, 4 or 8 bytes, which may straddle two pages.
+ */
+int Instruction_LoadWide(int pid, int va, int bytes) {
+    unsigned char buffer[8];
+    if (!InstructionCopy(pid, va, (char*)buffer, bytes, FALSE)) {
+        return 1;
+    }
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | buffer[i];
+    }
+    printf("The %d-bit value %llu was found at virtual address %d.\n", bytes * 8,
+           (unsigned long long)value, va);
+    return 0;
+}
 
-        int new_frame = Memsim_SwapIn(pid, vpn, swap_slot);
-        printf("Swapped disk slot %d into frame %d\n", swap_slot, new_frame);
-        pa = MMU_TranslateAddress(pid, vpn, offset);
+/*
+ * Stores a value as 1, 2, 4 or 8 little endian bytes, which may straddle two pages.
+ */
+int Instruction_StoreWide(int pid, int va, int bytes, uint64_t value) {
+    char buffer[8];
+    for (int i = 0; i < bytes; i++) {
+        buffer[i] = (char)(value >> (8 * i));
+    }
+    if (!InstructionCopy(pid, va, buffer, bytes, TRUE)) {
+        return 1;
     }
+    printf("Stored %d-bit value %llu at virtual address %d\n", bytes * 8,
+           (unsigned long long)value, va);
+    return 0;
+}
 
+/*
+ * Copies len bytes from src to dst within the address space of a process. The source is
+ * read in full before the destination is written, so the ranges may overlap.
+ */
+int Instruction_Memcpy(int pid, int src, int dst, int len) {
+    char buffer[VIRTUAL_SIZE];
+    if (len < 1 || len > VIRTUAL_SIZE) {
+        printf("Invalid length for memcpy instruction. Length must be 1-%d.\n", VIRTUAL_SIZE);
+        return 1;
+    }
+    if (!InstructionCopy(pid, src, buffer, len, FALSE) || !InstructionCopy(pid, dst, buffer, len, TRUE)) {
+        return 1;
+    }
+    printf("Copied %d bytes from virtual address %d to virtual address %d.\n", len, src, dst);
+    return 0;
+}
 
-int Instruction_Load(int pid, int va) {
-    int pa = MMU_TranslateAddress(pid, VPN(va), PAGE_OFFSET(va));
-    
-    // Ensure address is valid
-    if (pa == -1) {
-        printf("Error: The virtual address %d is not valid.\n", va);
+/*
+ * Creates the context of a new process and gives it an address space id. Processes are also
+ * created implicitly by their first instruction; the page table is allocated on first use.
+ */
+int Instruction_Create(int pid) {
+    if (Proc_Lookup(pid) != NULL) {
+        printf("Error: Process %d already exists.\n", pid);
         return 1;
     }
+    Process* proc = Proc_Get(pid);
+    printf("Created process %d (ASID %d).\n", pid, Proc_GetASID(proc));
+    return 0;
+}
 
-    int value = Memsim_Load(pa);
-    printf("The value %d is virtual address %d (physical address %d)\n", value, va, pa);
+/*
+ * Tears down a process, releasing all of its frames and swap slots.
+ */
+int Instruction_Exit(int pid) {
+    int frames, slots;
+    if (!PT_DestroyProcess(pid, &frames, &slots)) {
+        printf("Error: Process %d does not exist.\n", pid);
+        return 1;
+    }
+    printf("Process %d exited, freed %d frames and %d swap slots.\n", pid, frames, slots);
     return 0;
 }
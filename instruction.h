@@ -3,6 +3,8 @@
 #ifndef INSTRUCTION_H
 #define INSTRUCTION_H
 
+#include <stdint.h>
+
 /* 
  * Public Interface:
  */
@@ -10,6 +12,11 @@
 int Instruction_Map(int process_id, int virtual_address, int value);
 int Instruction_Store(int process_id, int virtual_address, int value);
 int Instruction_Load(int process_id, int virtual_address);
+int Instruction_LoadWide(int process_id, int virtual_address, int bytes);
+int Instruction_StoreWide(int process_id, int virtual_address, int bytes, uint64_t value);
+int Instruction_Memcpy(int process_id, int src_address, int dst_address, int length);
+int Instruction_Create(int process_id);
+int Instruction_Exit(int process_id);
 
 
 #endif // INSTRUCTION_H
\ No newline at end of file
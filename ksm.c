@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ksm.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "pagetable.h"
+#include "process.h"
+#include "pageops.h"
+
+/* Private Internals: */
+
+// Every scanInterval instructions the scanner looks at the next pagesToScan frames
+int scanInterval = 0;
+int pagesToScan = 0;
+int instructionsSinceScan = 0;
+
+int ksmRunning = FALSE;
+int ksmBatchPending = FALSE; // a batch handed to the scanner and not yet done
+pthread_t ksmThread;
+pthread_mutex_t ksmWaitLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t ksmWait = PTHREAD_COND_INITIALIZER;
+pthread_cond_t ksmBatchDone = PTHREAD_COND_INITIALIZER;
+
+int scanCursor = 0;
+long fullScans = 0;
+long merges = 0;
+
+// Content hash of each frame when it was last scanned. A private page is only merged once
+// it hashes the same on two scans in a row, so pages being written are left alone.
+uint64_t lastHash[NUM_FRAMES];
+
+/*
+ * Frames seen during the current pass, chained by content hash: shared frames and private
+ * pages that are merge candidates. Entries can go stale as frames change hands, so every
+ * match is checked again before merging.
+ */
+#define KSM_BUCKETS (NUM_FRAMES * 2)
+int bucketHead[KSM_BUCKETS];
+int bucketNext[NUM_FRAMES];
+long seenInPass[NUM_FRAMES];
+
+/* Private data page whose entry can be rewritten without faulting its page table in. */
+int KsmMergeable(int pfn) {
+    FrameInfo* info = Memsim_GetFrameInfo(pfn);
+    return Memsim_FrameInUse(pfn) && info->mapCount == 0 && info->vpn >= 0 && Proc_Get(info->pid)->ptPresent;
+}
+
+void KsmStartPass() {
+    for (int i = 0; i < KSM_BUCKETS; i++) {
+        bucketHead[i] = -1;
+    }
+    fullScans++;
+}
+
+/* Finds a frame seen this pass with the same bytes as pfn, or -1. Prefers shared frames. */
+int KsmFindDuplicate(int pfn, uint64_t hash) {
+    char* physmem = Memsim_GetPhysMem();
+    int match = -1;
+    for (int other = bucketHead[hash % KSM_BUCKETS]; other != -1; other = bucketNext[other]) {
+        FrameInfo* info = Memsim_GetFrameInfo(other);
+        if (other == pfn || lastHash[other] != hash || (info->mapCount == 0 && !KsmMergeable(other))
+            || !PageOps_Equal(&physmem[PAGE_START(other)], &physmem[PAGE_START(pfn)], PAGE_SIZE)) {
+            continue;
+        }
+        if (info->mapCount > 0) {
+            return other;
+        }
+        match = other;
+    }
+    return match;
+}
+
+void KsmScanFrame(int pfn) {
+    FrameInfo* info = Memsim_GetFrameInfo(pfn);
+    if (!Memsim_FrameInUse(pfn) || (info->mapCount == 0 && !KsmMergeable(pfn))) {
+        return;
+    }
+    uint64_t hash = PageOps_Checksum(&Memsim_GetPhysMem()[PAGE_START(pfn)], PAGE_SIZE);
+    if (info->mapCount == 0 && hash != lastHash[pfn]) {
+        lastHash[pfn] = hash;
+        return;
+    }
+    lastHash[pfn] = hash;
+
+    int keep = KsmFindDuplicate(pfn, hash);
+    if (keep != -1 && info->mapCount == 0) {
+        PT_MergeFrames(keep, pfn);
+        printf("Merged Frame %d into Frame %d.\n", pfn, keep);
+        merges++;
+    } else if (seenInPass[pfn] != fullScans) {
+        seenInPass[pfn] = fullScans;
+        bucketNext[pfn] = bucketHead[hash % KSM_BUCKETS];
+        bucketHead[hash % KSM_BUCKETS] = pfn;
+    }
+}
+
+/* Scans the next pagesToScan frames. Called holding the mm lock. */
+void KsmScan() {
+    for (int i = 0; i < pagesToScan; i++) {
+        if (scanCursor == 0) {
+            KsmStartPass();
+        }
+        KsmScanFrame(scanCursor);
+        scanCursor = (scanCursor + 1) % NUM_FRAMES;
+    }
+}
+
+/*
+ * Runs each batch handed over by Ksm_Poke. The poking thread keeps the mm lock and waits
+ * for the batch to finish, so the scan runs under that lock at a fixed point in the trace.
+ */
+void* KsmMain(void* unused) {
+    pthread_mutex_lock(&ksmWaitLock);
+    while (TRUE) {
+        while (ksmRunning && !ksmBatchPending) {
+            pthread_cond_wait(&ksmWait, &ksmWaitLock);
+        }
+        if (!ksmRunning) {
+            break;
+        }
+        pthread_mutex_unlock(&ksmWaitLock);
+
+        KsmScan();
+
+        pthread_mutex_lock(&ksmWaitLock);
+        ksmBatchPending = FALSE;
+        pthread_cond_signal(&ksmBatchDone);
+    }
+    pthread_mutex_unlock(&ksmWaitLock);
+    return NULL;
+}
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Starts the same page merging scanner. Every scanInterval instructions it hashes the next
+ * pagesToScan frames, merging data pages with identical bytes (across processes or within
+ * one) into a single copy-on-write shared frame.
+ */
+void Ksm_Start(int interval, int pages) {
+    scanInterval = interval;
+    pagesToScan = pages;
+    instructionsSinceScan = 0;
+    scanCursor = 0;
+    fullScans = 0;
+    merges = 0;
+    memset(lastHash, 0, sizeof(lastHash));
+    memset(seenInPass, 0, sizeof(seenInPass));
+    ksmRunning = TRUE;
+    pthread_create(&ksmThread, NULL, KsmMain, NULL);
+}
+
+/*
+ * Counts an instruction and, when a scan is due, hands the mm lock to the scanner and waits
+ * for its batch. Called holding the mm lock.
+ */
+void Ksm_Poke() {
+    if (!ksmRunning || ++instructionsSinceScan < scanInterval) {
+        return;
+    }
+    instructionsSinceScan = 0;
+    pthread_mutex_lock(&ksmWaitLock);
+    ksmBatchPending = TRUE;
+    pthread_cond_signal(&ksmWait);
+    while (ksmBatchPending) {
+        pthread_cond_wait(&ksmBatchDone, &ksmWaitLock);
+    }
+    pthread_mutex_unlock(&ksmWaitLock);
+}
+
+void Ksm_Stop() {
+    if (!ksmRunning) {
+        return;
+    }
+    pthread_mutex_lock(&ksmWaitLock);
+    ksmRunning = FALSE;
+    pthread_cond_signal(&ksmWait);
+    pthread_mutex_unlock(&ksmWaitLock);
+    pthread_join(ksmThread, NULL);
+}
+
+/* Prints how many frames sharing currently saves. */
+void Ksm_Report() {
+    if (scanInterval == 0) {
+        return;
+    }
+    int shared = 0, sharing = 0;
+    for (int pfn = 0; pfn < NUM_FRAMES; pfn++) {
+        FrameInfo* info = Memsim_GetFrameInfo(pfn);
+        if (Memsim_FrameInUse(pfn) && info->mapCount > 0) {
+            shared++;
+            sharing += info->mapCount;
+        }
+    }
+    printf("KSM: full scans %ld, merges %ld, shared frames %d mapped by %d pages, frames saved %d\n",
+           fullScans, merges, shared, sharing, sharing - shared);
+}
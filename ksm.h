@@ -0,0 +1,13 @@
+#ifndef KSM_H
+#define KSM_H
+
+/*
+ * Public Interface:
+ */
+
+void Ksm_Start(int scanInterval, int pagesToScan);
+void Ksm_Poke();
+void Ksm_Stop();
+void Ksm_Report();
+
+#endif // KSM_H
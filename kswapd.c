@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <pthread.h>
+
+#include "kswapd.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "pagetable.h"
+#include "policy.h"
+#include "process.h"
+#include "stats.h"
+
+/* Private Internals: */
+
+// Reclaim starts when fewer than lowWatermark frames are free and stops at highWatermark
+int lowWatermark = 0;
+int highWatermark = 0;
+
+int kswapdRunning = FALSE;
+int kswapdBalancePending = FALSE; // a balance handed to the reclaimer and not yet done
+pthread_t kswapdThread;
+pthread_mutex_t kswapdWaitLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t kswapdWait = PTHREAD_COND_INITIALIZER;
+pthread_cond_t kswapdBalanceDone = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Policy filter: frames that can be written back without faulting anything in, i.e.
+ * page tables and data pages whose page table is resident.
+ */
+int KswapdFrameReclaimable(int pfn, int unused) {
+    FrameInfo* info = Memsim_GetFrameInfo(pfn);
+    return info->vpn == FRAME_VPN_PAGETABLE || Proc_Get(info->pid)->ptPresent;
+}
+
+/* Evicts cold pages until the high watermark is reached. Called holding the mm lock. */
+void KswapdBalance() {
+    while (Memsim_NumFreeFrames() < highWatermark) {
+        int pfn = PT_EvictFrom(KswapdFrameReclaimable, 0);
+        if (pfn == -1) {
+            break;
+        }
+        Memsim_FreePFN(pfn);
+        Stats_BackgroundReclaim();
+    }
+}
+
+/*
+ * Runs each balance handed over by Kswapd_Poke. The poking thread keeps the mm lock and
+ * waits for the balance to finish, so it runs under that lock right after the instruction.
+ */
+void* KswapdMain(void* unused) {
+    pthread_mutex_lock(&kswapdWaitLock);
+    while (TRUE) {
+        while (kswapdRunning && !kswapdBalancePending) {
+            pthread_cond_wait(&kswapdWait, &kswapdWaitLock);
+        }
+        if (!kswapdRunning) {
+            break;
+        }
+        pthread_mutex_unlock(&kswapdWaitLock);
+
+        KswapdBalance();
+
+        pthread_mutex_lock(&kswapdWaitLock);
+        kswapdBalancePending = FALSE;
+        pthread_cond_signal(&kswapdBalanceDone);
+    }
+    pthread_mutex_unlock(&kswapdWaitLock);
+    return NULL;
+}
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Starts the background reclaimer. It sleeps until poked with fewer than lowWatermark free
+ * frames, then writes back cold pages between instructions until highWatermark frames are
+ * free, so the faulting path rarely has to evict inline.
+ */
+void Kswapd_Start(int low, int high) {
+    lowWatermark = low;
+    highWatermark = high;
+    kswapdRunning = TRUE;
+    pthread_create(&kswapdThread, NULL, KswapdMain, NULL);
+}
+
+/*
+ * If free memory is below the low watermark, hands the mm lock to the reclaimer and waits
+ * until it has balanced. Called holding the mm lock.
+ */
+void Kswapd_Poke() {
+    if (!kswapdRunning || Memsim_NumFreeFrames() >= lowWatermark) {
+        return;
+    }
+    pthread_mutex_lock(&kswapdWaitLock);
+    kswapdBalancePending = TRUE;
+    pthread_cond_signal(&kswapdWait);
+    while (kswapdBalancePending) {
+        pthread_cond_wait(&kswapdBalanceDone, &kswapdWaitLock);
+    }
+    pthread_mutex_unlock(&kswapdWaitLock);
+}
+
+void Kswapd_Stop() {
+    if (!kswapdRunning) {
+        return;
+    }
+    pthread_mutex_lock(&kswapdWaitLock);
+    kswapdRunning = FALSE;
+    pthread_cond_signal(&kswapdWait);
+    pthread_mutex_unlock(&kswapdWaitLock);
+    pthread_join(kswapdThread, NULL);
+}
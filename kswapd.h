@@ -0,0 +1,12 @@
+#ifndef KSWAPD_H
+#define KSWAPD_H
+
+/*
+ * Public Interface:
+ */
+
+void Kswapd_Start(int lowWatermark, int highWatermark);
+void Kswapd_Poke();
+void Kswapd_Stop();
+
+#endif // KSWAPD_H
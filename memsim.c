@@ -1,17 +1,67 @@
 // Starting code version 1.0
 
 #include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "memsim.h"
+#include "mmu.h"
+#include "zswap.h"
+#include "tier.h"
+#include "cost.h"
+#include "pageops.h"
+#include "checkpoint.h"
+#include "numa.h"
+#include "bitmap.h"
 
 /* Private Internals: */
 
-// Currently 'boolean' array (bitmap would be better for scale and perf)
-short freePages[NUM_PAGES];
+// Claimed frames, one bit each, so free frames are found a word at a time
+uint64_t frameUsedBits[BITMAP_WORDS(NUM_FRAMES)];
+int numFreeFrames = NUM_FRAMES;
+
+// NUMA nodes own consecutive runs of frames: node n has frames nodeStart[n] up to
+// nodeStart[n + 1], and its own allocator and free count
+int numNodes = 1;
+int nodeStart[NUMA_MAX_NODES + 1] = { 0, NUM_FRAMES };
+int nodeFree[NUMA_MAX_NODES] = { NUM_FRAMES };
+
+// Owner of each frame
+FrameInfo frameInfo[NUM_FRAMES];
+
+// Replacement state, laid out for the policy's sweeps: frames in use by the current
+// instruction, shared frames (never evicted), and the reference counter of each frame.
+// A sweep finds the next frame it may evict from a word of each bitmap. The time of
+// the last access and the number of accesses are kept for the LRU and LFU policies.
+uint64_t framePinnedBits[BITMAP_WORDS(NUM_FRAMES)];
+uint64_t frameSharedBits[BITMAP_WORDS(NUM_FRAMES)];
+unsigned char frameReferenced[NUM_FRAMES];
+long frameLastUse[NUM_FRAMES];
+int frameUses[NUM_FRAMES];
 
 // The simulated physical memory array (in bytes), aka physical R.A.M.
-char physmem[PHYSICAL_SIZE];
+// Aligned so the vector kernels can use aligned (streaming) stores on whole pages.
+// After a restore, physmem points into the mapped checkpoint file instead.
+char physmemStorage[PHYSICAL_SIZE] __attribute__((aligned(64)));
+char* physmem = physmemStorage;
+
+// Swap slot usage, slots are handed out next-fit from swapCursor
+short swapSlots[NUM_SWAP_SLOTS];
+int swapCursor = 0;
+
+// CRC32C of the page in each swap slot, checked whenever the slot is read back
+uint32_t swapChecksums[NUM_SWAP_SLOTS];
+long swapChecksumErrors = 0;
+
+// Frames and swap slots written since the last checkpoint, for incremental checkpoints.
+// Each is flagged once and listed, so a checkpoint visits only what changed.
+uint64_t frameDirtyBits[BITMAP_WORDS(NUM_FRAMES)];
+int dirtyFrames[NUM_FRAMES];
+int numDirtyFrames = 0;
+char slotDirty[NUM_SWAP_SLOTS];
+int dirtySlots[NUM_SWAP_SLOTS];
+int numDirtySlots = 0;
 
 /*
  * Performs sanity checks based on the simulations defined constants.
@@ -25,17 +75,217 @@ void MemsimConfigSanityChecks() { // you should not modify this function
     assert(NUM_PAGES == NUM_FRAMES);
 }
 
+/* Recounts the free frames of each node, after the free list was replaced. */
+void MemsimCountNodeFree() {
+    for (int node = 0; node < numNodes; node++) {
+        nodeFree[node] = nodeStart[node + 1] - nodeStart[node]
+                       - Bitmap_Count(frameUsedBits, nodeStart[node], nodeStart[node + 1]);
+    }
+}
+
+void MemsimMarkSlotDirty(int slot) {
+    if (!slotDirty[slot]) {
+        slotDirty[slot] = 1;
+        dirtySlots[numDirtySlots++] = slot;
+    }
+}
+
+void MemsimClearDirty() {
+    for (int i = 0; i < numDirtyFrames; i++) {
+        BITMAP_CLEAR(frameDirtyBits, dirtyFrames[i]);
+    }
+    for (int i = 0; i < numDirtySlots; i++) {
+        slotDirty[dirtySlots[i]] = 0;
+    }
+    numDirtyFrames = 0;
+    numDirtySlots = 0;
+}
+
+/* Saves the claimed frames, their owners and their replacement state. */
+void MemsimCheckpointFrames(FILE* file) {
+    Checkpoint_Write(file, frameUsedBits, sizeof(frameUsedBits));
+    Checkpoint_Write(file, &numFreeFrames, sizeof(numFreeFrames));
+    Checkpoint_Write(file, frameInfo, sizeof(frameInfo));
+    Checkpoint_Write(file, framePinnedBits, sizeof(framePinnedBits));
+    Checkpoint_Write(file, frameReferenced, sizeof(frameReferenced));
+    Checkpoint_Write(file, frameLastUse, sizeof(frameLastUse));
+    Checkpoint_Write(file, frameUses, sizeof(frameUses));
+}
+
+/* Restores what MemsimCheckpointFrames saved. Shared frames are found from their map counts. */
+int MemsimRestoreFrames(CheckpointReader* reader) {
+    if (!Checkpoint_ReadInto(reader, frameUsedBits, sizeof(frameUsedBits))
+        || !Checkpoint_ReadInto(reader, &numFreeFrames, sizeof(numFreeFrames))
+        || !Checkpoint_ReadInto(reader, frameInfo, sizeof(frameInfo))
+        || !Checkpoint_ReadInto(reader, framePinnedBits, sizeof(framePinnedBits))
+        || !Checkpoint_ReadInto(reader, frameReferenced, sizeof(frameReferenced))
+        || !Checkpoint_ReadInto(reader, frameLastUse, sizeof(frameLastUse))
+        || !Checkpoint_ReadInto(reader, frameUses, sizeof(frameUses))) {
+        return FALSE;
+    }
+    if (NUM_FRAMES % 64 != 0) {
+        frameUsedBits[NUM_FRAMES / 64] &= (1ull << (NUM_FRAMES % 64)) - 1;
+    }
+    for (int pfn = 0; pfn < NUM_FRAMES; pfn++) {
+        Memsim_SetShared(pfn, frameInfo[pfn].mapCount > 0);
+    }
+    MemsimCountNodeFree();
+    return TRUE;
+}
+
+/*
+ * Claims the next free swap slot, continuing from where the previous search left off
+ * so that recently freed slots are not immediately rewritten. Returns -1 if swap is full.
+ */
+int MemsimAllocSwapSlot() {
+    for (int i = 0; i < NUM_SWAP_SLOTS; i++) {
+        int slot = (swapCursor + i) % NUM_SWAP_SLOTS;
+        if (swapSlots[slot] == 0) {
+            swapSlots[slot] = 1;
+            MemsimMarkSlotDirty(slot);
+            swapCursor = (slot + 1) % NUM_SWAP_SLOTS;
+            return slot;
+        }
+    }
+    return -1;
+}
+
+void MemsimWriteSwapFile(int offset, const char* page) {
+    FILE* swapFile = MMU_GetSwapFileHandle();
+    fseek(swapFile, offset, SEEK_SET);
+    fwrite(page, PAGE_SIZE, 1, swapFile);
+    fflush(swapFile);
+}
+
+/*
+ * Offers a page to the compressed swap cache. When the pool is full its coldest entries
+ * are written back to their slots in the swap file until the page fits. Returns FALSE if
+ * the page has to go to the swap file itself.
+ */
+int MemsimStoreCompressed(int slot, const char* page) {
+    char coldPage[PAGE_SIZE];
+    for (;;) {
+        int result = Zswap_Store(slot, page);
+        if (result == ZSWAP_STORED) {
+            return TRUE;
+        } else if (result == ZSWAP_REJECTED) {
+            return FALSE;
+        }
+        int coldSlot = Zswap_WritebackColdest(coldPage);
+        if (coldSlot == -1) {
+            return FALSE;
+        }
+        MemsimWriteSwapFile(coldSlot * PAGE_SIZE, coldPage);
+        Cost_Charge(COST_WRITEBACK);
+        MemsimMarkSlotDirty(coldSlot);
+    }
+}
+
+/*
+ * Demotes a page to far memory. When it is full its coldest pages move on to the
+ * compressed pool or the swap file until the page fits. Returns FALSE if the page has
+ * to go there itself.
+ */
+int MemsimStoreFar(int slot, const char* page) {
+    char coldPage[PAGE_SIZE];
+    while (Tier_Store(slot, page) == TIER_FULL) {
+        int coldSlot = Tier_WritebackColdest(coldPage);
+        if (coldSlot == -1) {
+            return FALSE;
+        }
+        if (!Zswap_Enabled() || !MemsimStoreCompressed(coldSlot, coldPage)) {
+            MemsimWriteSwapFile(coldSlot * PAGE_SIZE, coldPage);
+            Cost_Charge(COST_WRITEBACK);
+        }
+        MemsimMarkSlotDirty(coldSlot);
+    }
+    return TRUE;
+}
+
 /*
- *  Public Interface: 
+ * Bytes at a physical address. Addresses past PHYSICAL_SIZE are in far memory, frame
+ * NUM_FRAMES being its first.
  */
+char* MemsimBytes(int physical_address) {
+    if (physical_address < PHYSICAL_SIZE) {
+        return &physmem[physical_address];
+    }
+    return Tier_FrameData(PFN(physical_address) - NUM_FRAMES) + PAGE_OFFSET(physical_address);
+}
 
-/* 
+/*
+ * Records a write at a physical address. A page written in far memory still belongs to
+ * its swap slot, so the slot's checksum follows the new contents.
+ */
+void MemsimWritten(int physical_address) {
+    if (physical_address < PHYSICAL_SIZE) {
+        Memsim_MarkDirty(PFN(physical_address));
+        return;
+    }
+    int far = PFN(physical_address) - NUM_FRAMES;
+    int slot = Tier_FrameSlot(far);
+    char scratch[PAGE_SIZE];
+    swapChecksums[slot] = PageOps_CopyCRC32C(scratch, Tier_FrameData(far), PAGE_SIZE);
+    MemsimMarkSlotDirty(slot);
+}
+
+/*
+ * Copies the page stored at a swap file offset into a buffer, leaving the slot in use.
+ * The page is checked against the checksum taken when it was swapped out; a mismatch is
+ * reported and counted, and the page is still returned as read. fromFile is set if the
+ * page had to be read from the swap file rather than far memory or the compressed pool.
+ * Returns -1 if the offset does not hold a page.
+ */
+int MemsimReadSwap(int swap_offset, char* page, int* fromFile) {
+    FILE* swapFile = MMU_GetSwapFileHandle();
+    int slot = swap_offset / PAGE_SIZE;
+    if (slot < 0 || slot >= NUM_SWAP_SLOTS || swapSlots[slot] == 0) {
+        return -1;
+    }
+
+    char staged[PAGE_SIZE];
+    *fromFile = !Tier_Load(slot, staged) && !Zswap_Load(slot, staged);
+    if (*fromFile) {
+        fseek(swapFile, swap_offset, SEEK_SET);
+        if (fread(staged, PAGE_SIZE, 1, swapFile) != 1) {
+            return -1;
+        }
+    }
+    if (PageOps_CopyCRC32C(page, staged, PAGE_SIZE) != swapChecksums[slot]) {
+        printf("Error: Swap slot at offset %d failed its checksum.\n", swap_offset);
+        swapChecksumErrors++;
+    }
+    return 0;
+}
+
+/*
+ *  Public Interface:
+ */
+
+/*
  * Zeroes out the simulated physical memory array.
  */
-void Memsim_Init() { // zero free pages list 
+void Memsim_Init() { // zero free pages list
     MemsimConfigSanityChecks();
-    memset(physmem, 0, sizeof(physmem)); // zero out physical memory
-	memset(freePages, 0, sizeof(freePages)); // zero implies free / FALSE / not used
+    PageOps_Init(); // pick the page copy/compare kernels for this CPU
+    physmem = physmemStorage;
+    memset(physmem, 0, PHYSICAL_SIZE); // zero out physical memory
+	memset(frameUsedBits, 0, sizeof(frameUsedBits)); // zero implies free / FALSE / not used
+    numFreeFrames = NUM_FRAMES;
+    Memsim_SetNodes(1);
+    memset(frameInfo, 0, sizeof(frameInfo));
+    memset(framePinnedBits, 0, sizeof(framePinnedBits));
+    memset(frameSharedBits, 0, sizeof(frameSharedBits));
+    memset(frameReferenced, 0, sizeof(frameReferenced));
+    memset(frameLastUse, 0, sizeof(frameLastUse));
+    memset(frameUses, 0, sizeof(frameUses));
+    memset(swapSlots, 0, sizeof(swapSlots));
+    swapCursor = 0;
+    swapChecksumErrors = 0;
+    memset(frameDirtyBits, 0, sizeof(frameDirtyBits));
+    memset(slotDirty, 0, sizeof(slotDirty));
+    numDirtyFrames = 0;
+    numDirtySlots = 0;
 }
 
  /* Gets current shared reference to start of simulated physical memory. */
@@ -44,61 +294,421 @@ char* Memsim_GetPhysMem() {
 }
 
 /*
- * Searches through the free page list to find the first free page in memory. 
- * It claims the page, marking it, and returns the physical address of the beginning 
- * of the page. If there are no free pages, returns -1;
+ * Searches through the free page list to find the first free page in memory.
+ * It claims the page, marking it, and returns the frame number of the page.
+ * If there are no free pages, returns -1;
  */
 int Memsim_FirstFreePFN() {
-    for (int i = 0; i < NUM_PAGES; i++) {  // Ensure frame 0 is used for page table
-        if (freePages[i] == 0) {
-            printf("Allocating frame %d\n", i);
-            freePages[i] = 1;
-            return i;
+    for (int node = 0; node < numNodes; node++) {
+        int pfn = Memsim_AllocFrameOnNode(node);
+        if (pfn != -1) {
+            return pfn;
         }
     }
-
     return -1;
 }
 
+/* Claims the first free frame of a NUMA node. Returns -1 if the node has none free. */
+int Memsim_AllocFrameOnNode(int node) {
+    if (nodeFree[node] == 0) {
+        return -1;
+    }
+    int pfn = Bitmap_FindNextZero(frameUsedBits, nodeStart[node], nodeStart[node + 1]);
+    if (pfn == -1) {
+        return -1;
+    }
+    BITMAP_SET(frameUsedBits, pfn);
+    numFreeFrames--;
+    nodeFree[node]--;
+    return pfn;
+}
+
+/* Splits the frames into count NUMA nodes of (nearly) equal size. */
+void Memsim_SetNodes(int count) {
+    numNodes = count;
+    for (int node = 0; node <= count; node++) {
+        nodeStart[node] = (int)((long)node * NUM_FRAMES / count);
+    }
+    MemsimCountNodeFree();
+}
+
+int Memsim_NumNodes() {
+    return numNodes;
+}
+
+/* First frame of a node. Node Memsim_NumNodes() gives the end of the last node. */
+int Memsim_NodeStart(int node) {
+    return nodeStart[node];
+}
+
+int Memsim_NodeOf(int pfn) {
+    int node = 0;
+    while (pfn >= nodeStart[node + 1]) {
+        node++;
+    }
+    return node;
+}
+
+int Memsim_NodeFreeFrames(int node) {
+    return nodeFree[node];
+}
+
+/* Returns a frame to the free list, clearing its contents and owner. */
+void Memsim_FreePFN(int pfn) {
+    BITMAP_CLEAR(frameUsedBits, pfn);
+    numFreeFrames++;
+    nodeFree[Memsim_NodeOf(pfn)]++;
+    PageOps_Zero(&physmem[PAGE_START(pfn)], PAGE_SIZE);
+    Memsim_MarkDirty(pfn);
+    Memsim_ResetFrame(pfn);
+}
+
+int Memsim_NumFreeFrames() {
+    return numFreeFrames;
+}
+
+/* Gets the reverse mapping and replacement state of a frame. */
+FrameInfo* Memsim_GetFrameInfo(int pfn) {
+    return &frameInfo[pfn];
+}
+
+int Memsim_FrameInUse(int pfn) {
+    return BITMAP_TEST(frameUsedBits, pfn);
+}
+
+/* Clears the owner and replacement state of a frame, which stays claimed. */
+void Memsim_ResetFrame(int pfn) {
+    memset(&frameInfo[pfn], 0, sizeof(FrameInfo));
+    BITMAP_CLEAR(framePinnedBits, pfn);
+    BITMAP_CLEAR(frameSharedBits, pfn);
+    frameReferenced[pfn] = 0;
+    frameLastUse[pfn] = 0;
+    frameUses[pfn] = 0;
+}
+
+/* Gives a claimed frame the owner and replacement state of another, for a page moving over. */
+void Memsim_CopyFrame(int dst, int src) {
+    frameInfo[dst] = frameInfo[src];
+    if (BITMAP_TEST(framePinnedBits, src)) {
+        BITMAP_SET(framePinnedBits, dst);
+    } else {
+        BITMAP_CLEAR(framePinnedBits, dst);
+    }
+    Memsim_SetShared(dst, BITMAP_TEST(frameSharedBits, src));
+    frameReferenced[dst] = frameReferenced[src];
+    frameLastUse[dst] = frameLastUse[src];
+    frameUses[dst] = frameUses[src];
+}
+
+/* Keeps a frame from being evicted until the current instruction completes. */
+void Memsim_Pin(int pfn) {
+    BITMAP_SET(framePinnedBits, pfn);
+}
+
+void Memsim_Unpin(int pfn) {
+    BITMAP_CLEAR(framePinnedBits, pfn);
+}
+
+int Memsim_IsPinned(int pfn) {
+    return BITMAP_TEST(framePinnedBits, pfn);
+}
+
+/* Marks a frame as mapped by several pages (or none in particular), never to be evicted. */
+void Memsim_SetShared(int pfn, int shared) {
+    if (shared) {
+        BITMAP_SET(frameSharedBits, pfn);
+    } else {
+        BITMAP_CLEAR(frameSharedBits, pfn);
+    }
+}
+
+/* Replacement policy reference counter of a frame. */
+int Memsim_GetReferenced(int pfn) {
+    return frameReferenced[pfn];
+}
+
+void Memsim_SetReferenced(int pfn, int chances) {
+    frameReferenced[pfn] = (unsigned char)chances;
+}
+
+/* Replacement policy time of the last access to a frame, 0 if not accessed since it was filled. */
+long Memsim_GetLastUse(int pfn) {
+    return frameLastUse[pfn];
+}
+
+/* Replacement policy count of accesses to a frame since it was filled. */
+int Memsim_GetUses(int pfn) {
+    return frameUses[pfn];
+}
+
+void Memsim_SetUse(int pfn, long lastUse, int uses) {
+    frameLastUse[pfn] = lastUse;
+    frameUses[pfn] = uses;
+}
+
+/*
+ * First frame at or after from that the replacement policy may evict: claimed, unpinned
+ * and private. Returns -1 if there is none up to the last frame.
+ */
+int Memsim_NextEvictable(int from) {
+    if (from >= NUM_FRAMES) {
+        return -1;
+    }
+    int word = from / 64;
+    uint64_t bits = (frameUsedBits[word] & ~framePinnedBits[word] & ~frameSharedBits[word])
+                  & (~0ull << (from % 64));
+    while (bits == 0) {
+        if (++word == BITMAP_WORDS(NUM_FRAMES)) {
+            return -1;
+        }
+        bits = frameUsedBits[word] & ~framePinnedBits[word] & ~frameSharedBits[word];
+    }
+    // Bits past the last frame are never set in frameUsedBits
+    return word * 64 + __builtin_ctzll(bits);
+}
+
+/* Releases the pins taken on frames while the last instruction executed. */
+void Memsim_UnpinAll() {
+    memset(framePinnedBits, 0, sizeof(framePinnedBits));
+    Tier_UnpinAll();
+}
+
 void Memsim_Store(int physical_address, int value) {
-    char* physmem = Memsim_GetPhysMem();
-    physmem[physical_address] = (char)value;
+    *MemsimBytes(physical_address) = (char)value;
+    MemsimWritten(physical_address);
+}
+
+/*
+ * Records that a frame's contents changed since the last checkpoint. Memsim marks its own
+ * writes; code writing physical memory directly (page table entries) must call this.
+ */
+void Memsim_MarkDirty(int pfn) {
+    if (!BITMAP_TEST(frameDirtyBits, pfn)) {
+        BITMAP_SET(frameDirtyBits, pfn);
+        dirtyFrames[numDirtyFrames++] = pfn;
+    }
 }
 
 int Memsim_Load(int physical_address) {
-    char* physmem = Memsim_GetPhysMem();
-    return (int)(unsigned char)physmem[physical_address];
+    return (int)(unsigned char)*MemsimBytes(physical_address);
+}
+
+/* Copies len bytes starting at a physical address out of memory. The range must not leave its page. */
+void Memsim_Read(int physical_address, char* dst, int len) {
+    memcpy(dst, MemsimBytes(physical_address), len);
 }
 
-// Swap storage (assuming a simple array for swap slots)
-#define SWAP_SIZE  NUM_PAGES
-char swap_space[SWAP_SIZE * PAGE_SIZE];  // Simulated disk swap space
-int swap_slots[SWAP_SIZE];               // Keeps track of used swap slots
+/* Copies len bytes into memory at a physical address. The range must not leave its page. */
+void Memsim_Write(int physical_address, const char* src, int len) {
+    memcpy(MemsimBytes(physical_address), src, len);
+    MemsimWritten(physical_address);
+}
 
+/*
+ * Writes the contents of a frame to the swap file and clears the frame.
+ * The frame stays claimed so the caller can reuse it.
+ * Returns the byte offset in the swap file, or -1 if swap is full.
+ */
 int Memsim_SwapOut(int frame_number) {
-    for (int i = 0; i < SWAP_SIZE; i++) {
-        if (swap_slots[i] == 0) { 
-            memcpy(&swap_space[i * PAGE_SIZE], &physmem[frame_number * PAGE_SIZE], PAGE_SIZE);
-            swap_slots[i] = 1;
-            freePages[frame_number] = 0; 
-            return i;
-        }
+    int slot = MemsimAllocSwapSlot();
+    if (slot == -1) {
+        return -1;
     }
-    return -1;
+
+    // Stage the page for writing, checksumming it on the way
+    int offset = slot * PAGE_SIZE;
+    char staged[PAGE_SIZE];
+    char* page = &physmem[PAGE_START(frame_number)];
+    swapChecksums[slot] = PageOps_CopyCRC32C(staged, page, PAGE_SIZE);
+    if ((!Tier_Enabled() || !MemsimStoreFar(slot, staged))
+        && (!Zswap_Enabled() || !MemsimStoreCompressed(slot, staged))) {
+        MemsimWriteSwapFile(offset, staged);
+        Cost_Charge(COST_WRITEBACK);
+    }
+    PageOps_ZeroStream(page, PAGE_SIZE); // the evicted contents will not be read again
+    Memsim_MarkDirty(frame_number);
+    return offset;
 }
 
-int Memsim_SwapIn(int pid, int vpn, int swap_slot) {
-    if (swap_slot < 0 || swap_slot >= SWAP_SIZE || swap_slots[swap_slot] == 0) {
+/*
+ * Reads the page stored at a swap file offset into a (claimed) frame and releases
+ * the swap slot. Returns the frame number, or -1 if the offset does not hold a page.
+ */
+int Memsim_SwapIn(int frame_number, int swap_offset) {
+    int fromFile;
+    if (MemsimReadSwap(swap_offset, &physmem[PAGE_START(frame_number)], &fromFile) == -1) {
         return -1;
     }
+    Cost_Charge(fromFile ? COST_MAJOR_FAULT : COST_MINOR_FAULT);
+    Memsim_MarkDirty(frame_number);
+    Memsim_FreeSwap(swap_offset);
+    return frame_number;
+}
+
+/* Copies the page stored at a swap file offset into a buffer. See MemsimReadSwap. */
+int Memsim_ReadSwap(int swap_offset, char* page) {
+    int fromFile;
+    return MemsimReadSwap(swap_offset, page, &fromFile);
+}
+
+/* Number of pages read back from swap that did not match their checksum. */
+long Memsim_SwapChecksumErrors() {
+    return swapChecksumErrors;
+}
+
+/* Releases the swap slot at a swap file offset. */
+void Memsim_FreeSwap(int swap_offset) {
+    int slot = swap_offset / PAGE_SIZE;
+    if (slot >= 0 && slot < NUM_SWAP_SLOTS) {
+        Tier_Invalidate(slot);
+        Zswap_Invalidate(slot);
+        swapSlots[slot] = 0;
+        MemsimMarkSlotDirty(slot);
+    }
+}
 
-    int new_frame = Memsim_FirstFreePFN();
-    if (new_frame == -1) return -1;
+/*
+ * Returns the byte a frame is filled with if every byte of it is the same, or -1.
+ * A page is same-filled exactly when it equals itself shifted by one byte, which lets
+ * the vectorized compare do the scan.
+ */
+int Memsim_PageFillValue(int frame_number) {
+    const char* page = &physmem[PAGE_START(frame_number)];
+    if (!PageOps_Equal(page, page + 1, PAGE_SIZE - 1)) {
+        return -1;
+    }
+    return (unsigned char)page[0];
+}
 
-    memcpy(&physmem[new_frame * PAGE_SIZE], &swap_space[swap_slot * PAGE_SIZE], PAGE_SIZE);
-    swap_slots[swap_slot] = 0;
+/*
+ * Saves physical memory, frame and swap slot state, and the contents of every used swap
+ * slot (as stored in the swap file). Starts dirty tracking over for the next increment.
+ */
+void Memsim_Checkpoint(FILE* file) {
+    Checkpoint_WriteAlign(file, 64);
+    Checkpoint_Write(file, physmem, PHYSICAL_SIZE);
+    MemsimCheckpointFrames(file);
+    Checkpoint_Write(file, swapSlots, sizeof(swapSlots));
+    Checkpoint_Write(file, &swapCursor, sizeof(swapCursor));
+    Checkpoint_Write(file, swapChecksums, sizeof(swapChecksums));
+    Checkpoint_Write(file, &swapChecksumErrors, sizeof(swapChecksumErrors));
 
-    PT_SetPTE(pid, vpn, new_frame, 1, 1, 1, 0);
-    return new_frame;
+    FILE* swapFile = MMU_GetSwapFileHandle();
+    char page[PAGE_SIZE];
+    for (int slot = 0; slot < NUM_SWAP_SLOTS; slot++) {
+        if (swapSlots[slot] == 0) {
+            continue;
+        }
+        // Slots held by far memory or the compressed pool may never have been written to the file
+        fseek(swapFile, slot * PAGE_SIZE, SEEK_SET);
+        if (fread(page, PAGE_SIZE, 1, swapFile) != 1) {
+            memset(page, 0, PAGE_SIZE);
+        }
+        Checkpoint_Write(file, page, PAGE_SIZE);
+    }
+    MemsimClearDirty();
 }
 
+/* Restores what Memsim_Checkpoint saved, writing the swap slots back to the swap file. */
+int Memsim_Restore(CheckpointReader* reader) {
+    Checkpoint_ReadAlign(reader, 64);
+    char* image = (char*)Checkpoint_Read(reader, PHYSICAL_SIZE);
+    if (image == NULL
+        || !MemsimRestoreFrames(reader)
+        || !Checkpoint_ReadInto(reader, swapSlots, sizeof(swapSlots))
+        || !Checkpoint_ReadInto(reader, &swapCursor, sizeof(swapCursor))
+        || !Checkpoint_ReadInto(reader, swapChecksums, sizeof(swapChecksums))
+        || !Checkpoint_ReadInto(reader, &swapChecksumErrors, sizeof(swapChecksumErrors))) {
+        return FALSE;
+    }
+    physmem = image;
+
+    for (int slot = 0; slot < NUM_SWAP_SLOTS; slot++) {
+        if (swapSlots[slot] == 0) {
+            continue;
+        }
+        const char* page = Checkpoint_Read(reader, PAGE_SIZE);
+        if (page == NULL) {
+            return FALSE;
+        }
+        MemsimWriteSwapFile(slot * PAGE_SIZE, page);
+    }
+    MemsimClearDirty();
+    return TRUE;
+}
+
+/*
+ * Saves what changed since the previous checkpoint: the frames and swap slots written
+ * since then, with their contents. Page table entries live in frames, so changed entries
+ * are saved with their frame. Frame metadata is a few words per frame and is saved whole.
+ */
+void Memsim_CheckpointIncrement(FILE* file) {
+    MemsimCheckpointFrames(file);
+    Checkpoint_Write(file, &swapCursor, sizeof(swapCursor));
+    Checkpoint_Write(file, &swapChecksumErrors, sizeof(swapChecksumErrors));
+
+    Checkpoint_Write(file, &numDirtyFrames, sizeof(numDirtyFrames));
+    for (int i = 0; i < numDirtyFrames; i++) {
+        Checkpoint_Write(file, &dirtyFrames[i], sizeof(int));
+        Checkpoint_Write(file, &physmem[PAGE_START(dirtyFrames[i])], PAGE_SIZE);
+    }
+
+    FILE* swapFile = MMU_GetSwapFileHandle();
+    char page[PAGE_SIZE];
+    Checkpoint_Write(file, &numDirtySlots, sizeof(numDirtySlots));
+    for (int i = 0; i < numDirtySlots; i++) {
+        int slot = dirtySlots[i];
+        Checkpoint_Write(file, &slot, sizeof(slot));
+        Checkpoint_Write(file, &swapSlots[slot], sizeof(swapSlots[slot]));
+        if (swapSlots[slot] == 0) {
+            continue;
+        }
+        Checkpoint_Write(file, &swapChecksums[slot], sizeof(swapChecksums[slot]));
+        fseek(swapFile, slot * PAGE_SIZE, SEEK_SET);
+        if (fread(page, PAGE_SIZE, 1, swapFile) != 1) {
+            memset(page, 0, PAGE_SIZE);
+        }
+        Checkpoint_Write(file, page, PAGE_SIZE);
+    }
+    MemsimClearDirty();
+}
+
+/* Applies what Memsim_CheckpointIncrement saved on top of the restored state. */
+int Memsim_RestoreIncrement(CheckpointReader* reader) {
+    int count;
+    if (!MemsimRestoreFrames(reader)
+        || !Checkpoint_ReadInto(reader, &swapCursor, sizeof(swapCursor))
+        || !Checkpoint_ReadInto(reader, &swapChecksumErrors, sizeof(swapChecksumErrors))
+        || !Checkpoint_ReadInto(reader, &count, sizeof(count))) {
+        return FALSE;
+    }
+    for (int i = 0; i < count; i++) {
+        int pfn;
+        if (!Checkpoint_ReadInto(reader, &pfn, sizeof(pfn)) || pfn < 0 || pfn >= NUM_FRAMES
+            || !Checkpoint_ReadInto(reader, &physmem[PAGE_START(pfn)], PAGE_SIZE)) {
+            return FALSE;
+        }
+    }
+
+    if (!Checkpoint_ReadInto(reader, &count, sizeof(count))) {
+        return FALSE;
+    }
+    for (int i = 0; i < count; i++) {
+        int slot;
+        if (!Checkpoint_ReadInto(reader, &slot, sizeof(slot)) || slot < 0 || slot >= NUM_SWAP_SLOTS
+            || !Checkpoint_ReadInto(reader, &swapSlots[slot], sizeof(swapSlots[slot]))) {
+            return FALSE;
+        }
+        if (swapSlots[slot] == 0) {
+            continue;
+        }
+        const char* page;
+        if (!Checkpoint_ReadInto(reader, &swapChecksums[slot], sizeof(swapChecksums[slot]))
+            || (page = Checkpoint_Read(reader, PAGE_SIZE)) == NULL) {
+            return FALSE;
+        }
+        MemsimWriteSwapFile(slot * PAGE_SIZE, page);
+    }
+    MemsimClearDirty();
+    return TRUE;
+}
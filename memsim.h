@@ -4,6 +4,9 @@
 #define MEMSIM_H
 
 #include <assert.h>
+#include <stdio.h>
+
+#include "checkpoint.h"
 
 /*
  * Public Interface:
@@ -12,7 +15,7 @@
 #define PAGE_SIZE 16
 
 #define PHYSICAL_SIZE 64
-#define VIRTUAL_SIZE 64 
+#define VIRTUAL_SIZE 64
 
 #define MAX_VA 255
 #define MAX_PA 255
@@ -20,23 +23,78 @@
 #define NUM_PAGES (PHYSICAL_SIZE/PAGE_SIZE)
 #define NUM_FRAMES NUM_PAGES
 
+// Swap device size, in page-sized slots
+#define NUM_SWAP_SLOTS 4096
+
 // Address getters
-#define PAGE_START(i) (i * PAGE_SIZE)
-#define PAGE_OFFSET(addr) (addr % PAGE_SIZE)
-#define VPN(addr) (addr / PAGE_SIZE)
-#define PFN(addr) (addr / PAGE_SIZE)
-#define PAGE_NUM(addr) (addr / PAGE_SIZE)
+#define PAGE_START(i) ((i) * PAGE_SIZE)
+#define PAGE_OFFSET(addr) ((addr) % PAGE_SIZE)
+#define VPN(addr) ((addr) / PAGE_SIZE)
+#define PFN(addr) ((addr) / PAGE_SIZE)
+#define PAGE_NUM(addr) ((addr) / PAGE_SIZE)
+
+// Frame owner VPN used for frames holding a page table rather than a data page
+#define FRAME_VPN_PAGETABLE -1
 
-// Public functions 
+// Frame owner VPN of a shared frame (the zero frame or merged pages), which belongs to
+// no process. The pages mapping it are found through the page table reverse map.
+#define FRAME_VPN_SHARED -2
+
+/*
+ * Reverse mapping from a physical frame to the page it holds.
+ * Used by eviction to find the page table entry (or page table register) that must be
+ * updated. The state the replacement policy scans on every sweep (claimed, pinned, shared,
+ * reference counter) is kept apart from it, in bitmaps and a byte per frame.
+ */
+typedef struct {
+    int pid;         // Owning process
+    int vpn;         // Virtual page held, or FRAME_VPN_PAGETABLE
+    int prefetched;  // Brought in by readahead and not accessed yet
+    int mapCount;    // Pages mapping a shared frame, never evicted; 0 if private
+    int remoteAccesses; // Accesses by its owner from another NUMA node, since it arrived
+} FrameInfo;
+
+// Public functions
 void Memsim_Init();
 char* Memsim_GetPhysMem();
 int Memsim_FirstFreePFN();
-// Add these missing function declarations
+int Memsim_AllocFrameOnNode(int node);
+void Memsim_SetNodes(int count);
+int Memsim_NumNodes();
+int Memsim_NodeStart(int node);
+int Memsim_NodeOf(int pfn);
+int Memsim_NodeFreeFrames(int node);
+void Memsim_FreePFN(int pfn);
+int Memsim_NumFreeFrames();
+FrameInfo* Memsim_GetFrameInfo(int pfn);
+int Memsim_FrameInUse(int pfn);
+void Memsim_ResetFrame(int pfn);
+void Memsim_CopyFrame(int dst, int src);
+void Memsim_Pin(int pfn);
+void Memsim_Unpin(int pfn);
+int Memsim_IsPinned(int pfn);
+void Memsim_SetShared(int pfn, int shared);
+int Memsim_GetReferenced(int pfn);
+void Memsim_SetReferenced(int pfn, int chances);
+long Memsim_GetLastUse(int pfn);
+int Memsim_GetUses(int pfn);
+void Memsim_SetUse(int pfn, long lastUse, int uses);
+int Memsim_NextEvictable(int from);
+void Memsim_UnpinAll();
 void Memsim_Store(int physical_address, int value);
+void Memsim_MarkDirty(int pfn);
 int Memsim_Load(int physical_address);
+void Memsim_Read(int physical_address, char* dst, int len);
+void Memsim_Write(int physical_address, const char* src, int len);
 int Memsim_SwapOut(int frame_number);
-int Memsim_SwapIn(int pid, int vpn, int swap_slot);
-
-
+int Memsim_SwapIn(int frame_number, int swap_offset);
+int Memsim_ReadSwap(int swap_offset, char* page);
+void Memsim_FreeSwap(int swap_offset);
+long Memsim_SwapChecksumErrors();
+void Memsim_Checkpoint(FILE* file);
+int Memsim_Restore(CheckpointReader* reader);
+void Memsim_CheckpointIncrement(FILE* file);
+int Memsim_RestoreIncrement(CheckpointReader* reader);
+int Memsim_PageFillValue(int frame_number);
 
-#endif // MEMSIM_H
\ No newline at end of file
+#endif // MEMSIM_H
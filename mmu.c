@@ -2,13 +2,53 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
 #include "mmu.h"
 #include "memsim.h"
 #include "pagetable.h"
 #include "input.h"
+#include "policy.h"
+#include "process.h"
+#include "stats.h"
+#include "kswapd.h"
+#include "zswap.h"
+#include "ksm.h"
+#include "readahead.h"
+#include "checkpoint.h"
+#include "eventlog.h"
+#include "workload.h"
+#include "numa.h"
+#include "tier.h"
+#include "cost.h"
+#include "arena.h"
+#include "adaptive.h"
+#include "opt.h"
+#include "pipeline.h"
 
 /* Private Internals: */
 
+// Translation lookaside buffer, direct mapped and tagged with address space ids
+#define TLB_SIZE 16
+
+typedef struct {
+	int valid;
+	int asid;
+	int vpn;
+	int pfn;
+	int dirty;  // The entry was filled by a store, so stores may skip the page table walk
+} TLBEntry;
+
+TLBEntry tlb[TLB_SIZE];
+
+// Serializes instructions with background work (page reclaim) on the simulated memory
+pthread_mutex_t mmLock = PTHREAD_MUTEX_INITIALIZER;
+
+int MMUTLBIndex(int asid, int VPN) {
+	return (VPN ^ (asid * 7)) % TLB_SIZE;
+}
+
 // Swapping functionality
 #define DISK_SWAP_FILE_PATH ((const char*) "./disk.txt")
 FILE* swapFileHandle;
@@ -18,22 +58,369 @@ void MMUOpenSwapFile() {
 	swapFileHandle = fopen(DISK_SWAP_FILE_PATH,"w+");
 }
 
-void MMUInit() {
+/* Simulation settings chosen on the command line. */
+typedef struct {
+	int policy;
+	int sampleInterval;
+	int tau;
+	const char* seriesPath;
+	int report;
+	char** limits;        // -m arguments, applied once processes can be configured
+	int numLimits;
+	int lowWatermark;     // Background reclaim free frame watermarks (0: no kswapd)
+	int highWatermark;
+	int readahead;        // Max swap-in readahead window in pages (0: off)
+	int zswapBytes;       // Compressed swap cache pool size (0: off)
+	int dedup;            // Same-filled page detection and zero frame mapping
+	int ksmInterval;      // Same page merging scan interval in instructions (0: off)
+	int ksmPages;         // Frames looked at per scan
+	char** restorePaths;  // Checkpoint chain to resume from: a full one, then its increments
+	int numRestores;
+	const char* compactPath; // Write the restored chain as one full checkpoint and exit
+	const char* eventLogPath; // Binary log of faults, evictions, swap-ins and TLB misses
+	int generate;         // Run a generated workload instead of reading input
+	WorkloadSpec workload;
+	NumaSpec numa;        // NUMA node layout (one node: off)
+	TierSpec tier;        // Far memory between DRAM and swap (0 frames: off)
+	CostSpec cost;        // Modeled cycles per event (not enabled: off)
+	AdaptiveSpec adaptive; // Policy switching on ghost cache hits (not enabled: off)
+	int hugePages;        // Back the metadata arena with huge pages
+	PipelineSpec async;   // Overlap swap-ins with other processes' lines (not enabled: off)
+	char** placements;    // -P arguments, applied once processes can be configured
+	int numPlacements;
+} MMUOptions;
+
+void MMUUsage(const char* prog) {
+	printf("Usage: %s [-r rr|clock|lru|lfu|opt] [-m pid:hard[:soft]]... [-k low:high] [-a window] [-z bytes] [-d] [-K interval:pages] [-s interval] [-t tau] [-w file] [-e file] [-S] [--restore file]... [--compact file] [--gen spec] [--numa spec] [-P pid:policy]... [--tier spec] [--cost spec] [-H] [--adaptive spec] [--async spec]\n" \
+		   "  -r  page replacement policy (default rr), opt reads the whole input first and\n" \
+		   "      compares the faults of the others against it\n" \
+		   "  -m  limit resident frames of pid (or of every process if pid is *)\n" \
+		   "  -k  reclaim in the background when fewer than low frames are free, up to high\n" \
+		   "  -a  on strided swap-in faults, read up to window pages ahead\n" \
+		   "  -z  keep swapped out pages compressed in a pool of bytes before writing them to disk\n" \
+		   "  -d  swap out same-filled pages as their fill byte, map new pages to a shared zero frame\n" \
+		   "  -K  every interval instructions, merge identical pages among the next pages frames\n" \
+		   "  -s  sample reference bits every interval instructions\n" \
+		   "  -t  working set window in instructions (default 4 intervals)\n" \
+		   "  -w  write per process rss/wss/swap/fault samples to file as CSV\n" \
+		   "  -e  log faults, evictions, swap-ins and TLB misses to file (see mmutrace)\n" \
+		   "  -S  print per process statistics at the end\n" \
+		   "  -R, --restore  resume from a file written by a checkpoint line, repeat for each increment\n" \
+		   "  -C, --compact  write the restored checkpoint chain to file as one full checkpoint and exit\n" \
+		   "  -G, --gen  generate the input from key=value pairs: n, procs, pages, writes, seed, quiet,\n" \
+		   "             dist=uniform|zipf|seq|hotcold|phase, theta, stride, hot=fraction:accesses, phase\n" \
+		   "  -N, --numa  split memory into NUMA nodes: nodes, distance=d/d/..., migrate\n" \
+		   "  -P  place frames of pid (or of every process if pid is *) by local, interleave or preferred:node\n" \
+		   "  -T, --tier  demote evicted pages to far memory before swap: frames, dram, far, swap (ns),\n" \
+		   "              promote (sampled accesses), sample (interval)\n" \
+		   "  -c, --cost  charge modeled cycles per event: tlb, walk, minor, major, writeback, zero,\n" \
+		   "              or default\n" \
+		   "  -H, --hugepages  back simulator metadata with huge pages\n" \
+		   "  -A, --adaptive  switch to the policy ghost caches find best: window (references),\n" \
+		   "                  margin (percent), policies=rr+clock+lru+lfu\n" \
+		   "  -y, --async  run other processes' lines while one waits on a swap-in: window (lines),\n" \
+		   "               depth (reads in flight); timed by the cost model (default costs without -c)\n", prog);
+}
+
+/*
+ * Parses a -m pid:hard[:soft] limit. pid * (returned as -1) applies to every process.
+ * Returns FALSE if it is malformed.
+ */
+int MMUParseLimit(const char* arg, int* pidOut, int* hardOut, int* softOut) {
+	int used = 0;
+	*softOut = 0;
+	if (arg[0] == '*') {
+		*pidOut = -1;
+		if (sscanf(arg, "*:%d%n", hardOut, &used) != 1) {
+			return FALSE;
+		}
+	} else if (sscanf(arg, "%d:%d%n", pidOut, hardOut, &used) != 2) {
+		return FALSE;
+	}
+	if (arg[used] == ':' && sscanf(arg + used, ":%d", softOut) != 1) {
+		return FALSE;
+	}
+	// A process needs a frame for its page table and one for the page it accesses
+	return *hardOut == 0 || *hardOut >= 2;
+}
+
+/* Parses a whole, non-negative count. Returns FALSE if it is malformed. */
+int MMUParseCount(const char* arg, int* countOut) {
+	int used = 0;
+	return sscanf(arg, "%d%n", countOut, &used) == 1 && arg[used] == '\0' && *countOut >= 0;
+}
+
+/* Frees the lists of option arguments once MMUInit has applied them. */
+void MMUFreeOptions(MMUOptions* options) {
+	free(options->limits);
+	free(options->restorePaths);
+	free(options->placements);
+}
+
+/* Reads command line options. Returns FALSE if they are invalid. */
+int MMUParseArgs(int argc, char* argv[], MMUOptions* options) {
+	int opt;
+	options->policy = POLICY_RR;
+	options->sampleInterval = 0;
+	options->tau = 0;
+	options->seriesPath = NULL;
+	options->report = FALSE;
+	options->limits = malloc(argc * sizeof(char*));
+	options->numLimits = 0;
+	options->lowWatermark = 0;
+	options->highWatermark = 0;
+	options->readahead = 0;
+	options->zswapBytes = 0;
+	options->dedup = FALSE;
+	options->ksmInterval = 0;
+	options->ksmPages = 0;
+	options->restorePaths = malloc(argc * sizeof(char*));
+	options->numRestores = 0;
+	options->compactPath = NULL;
+	options->eventLogPath = NULL;
+	options->generate = FALSE;
+	Numa_Parse("", &options->numa);
+	Tier_Parse("frames=0", &options->tier);
+	options->cost.enabled = FALSE;
+	options->adaptive.enabled = FALSE;
+	options->hugePages = FALSE;
+	options->async.enabled = FALSE;
+	options->placements = malloc(argc * sizeof(char*));
+	options->numPlacements = 0;
+	static struct option longOptions[] = {
+		{ "restore", required_argument, NULL, 'R' },
+		{ "compact", required_argument, NULL, 'C' },
+		{ "gen", required_argument, NULL, 'G' },
+		{ "numa", required_argument, NULL, 'N' },
+		{ "tier", required_argument, NULL, 'T' },
+		{ "cost", required_argument, NULL, 'c' },
+		{ "hugepages", no_argument, NULL, 'H' },
+		{ "adaptive", required_argument, NULL, 'A' },
+		{ "async", required_argument, NULL, 'y' },
+		{ NULL, 0, NULL, 0 }
+	};
+	while ((opt = getopt_long(argc, argv, "r:m:k:a:z:dK:s:t:w:e:SR:C:G:N:P:T:c:HA:y:", longOptions, NULL)) != -1) {
+		switch (opt) {
+		case 'r':
+			if ((options->policy = Policy_FromName(optarg)) == -1) {
+				printf("Unknown replacement policy '%s'.\n", optarg);
+				return FALSE;
+			}
+			break;
+		case 'm': {
+			int pid, hard, soft;
+			if (!MMUParseLimit(optarg, &pid, &hard, &soft)) {
+				printf("Invalid limit '%s'. Use pid:hard[:soft] with hard 0 (none) or at least 2.\n", optarg);
+				return FALSE;
+			}
+			options->limits[options->numLimits++] = optarg;
+			break;
+		}
+		case 'k':
+			if (sscanf(optarg, "%d:%d", &options->lowWatermark, &options->highWatermark) != 2
+				|| options->lowWatermark < 1 || options->highWatermark < options->lowWatermark
+				|| options->highWatermark > NUM_FRAMES) {
+				printf("Invalid watermarks '%s'. Use low:high with 1 <= low <= high <= %d.\n", optarg, NUM_FRAMES);
+				return FALSE;
+			}
+			break;
+		case 'a':
+			if (!MMUParseCount(optarg, &options->readahead)) {
+				printf("Invalid readahead '%s'. Use a page count of 0 or more.\n", optarg);
+				return FALSE;
+			}
+			break;
+		case 'z':
+			if (!MMUParseCount(optarg, &options->zswapBytes)) {
+				printf("Invalid pool size '%s'. Use a byte count of 0 or more.\n", optarg);
+				return FALSE;
+			}
+			break;
+		case 'd':
+			options->dedup = TRUE;
+			break;
+		case 'K':
+			if (sscanf(optarg, "%d:%d", &options->ksmInterval, &options->ksmPages) != 2
+				|| options->ksmInterval < 1 || options->ksmPages < 1) {
+				printf("Invalid scan rate '%s'. Use interval:pages, both at least 1.\n", optarg);
+				return FALSE;
+			}
+			break;
+		case 's':
+			if (!MMUParseCount(optarg, &options->sampleInterval)) {
+				printf("Invalid sample interval '%s'. Use an instruction count of 0 or more.\n", optarg);
+				return FALSE;
+			}
+			break;
+		case 't':
+			if (!MMUParseCount(optarg, &options->tau)) {
+				printf("Invalid window '%s'. Use an instruction count of 0 or more.\n", optarg);
+				return FALSE;
+			}
+			break;
+		case 'w':
+			options->seriesPath = optarg;
+			break;
+		case 'e':
+			options->eventLogPath = optarg;
+			break;
+		case 'S':
+			options->report = TRUE;
+			break;
+		case 'R':
+			options->restorePaths[options->numRestores++] = optarg;
+			break;
+		case 'C':
+			options->compactPath = optarg;
+			break;
+		case 'G':
+			if (!Workload_Parse(optarg, &options->workload)) {
+				return FALSE;
+			}
+			options->generate = TRUE;
+			break;
+		case 'N':
+			if (!Numa_Parse(optarg, &options->numa)) {
+				return FALSE;
+			}
+			break;
+		case 'P': {
+			int pid, policy, node;
+			if (!Numa_ParsePolicy(optarg, &pid, &policy, &node)) {
+				printf("Invalid placement '%s'. Use pid:local, pid:interleave or pid:preferred:node.\n", optarg);
+				return FALSE;
+			}
+			options->placements[options->numPlacements++] = optarg;
+			break;
+		}
+		case 'T':
+			if (!Tier_Parse(optarg, &options->tier)) {
+				return FALSE;
+			}
+			break;
+		case 'c':
+			if (!Cost_Parse(optarg, &options->cost)) {
+				return FALSE;
+			}
+			break;
+		case 'H':
+			options->hugePages = TRUE;
+			break;
+		case 'A':
+			if (!Adaptive_Parse(optarg, &options->adaptive)) {
+				return FALSE;
+			}
+			break;
+		case 'y':
+			if (!Pipeline_Parse(optarg, &options->async)) {
+				return FALSE;
+			}
+			break;
+		default:
+			return FALSE;
+		}
+	}
+	if (options->seriesPath != NULL && options->sampleInterval <= 0) {
+		printf("-w needs a sample interval (-s).\n");
+		return FALSE;
+	}
+	for (int i = 0; i < options->numPlacements; i++) {
+		int pid, policy, node;
+		Numa_ParsePolicy(options->placements[i], &pid, &policy, &node);
+		if (node >= options->numa.nodes) {
+			printf("Invalid placement '%s'. Node must be below %d.\n", options->placements[i], options->numa.nodes);
+			return FALSE;
+		}
+	}
+	if (options->policy == POLICY_OPT && (options->generate || options->adaptive.enabled)) {
+		printf("-r opt needs the input ahead of time and cannot switch policy (--gen, --adaptive).\n");
+		return FALSE;
+	}
+	if (options->async.enabled && (options->generate || options->policy == POLICY_OPT)) {
+		printf("--async reads its own input ahead (not with --gen or -r opt).\n");
+		return FALSE;
+	}
+	if (options->async.enabled && !options->cost.enabled) {
+		Cost_Parse("default", &options->cost); // The pipeline runs on modeled time
+	}
+	if (options->compactPath != NULL && options->numRestores == 0) {
+		printf("--compact needs a checkpoint chain to restore (--restore).\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Sets up every module from the options. Returns FALSE if the checkpoint cannot be restored. */
+int MMUInit(MMUOptions* options) {
+	Arena_Configure(options->hugePages); // Before any metadata is allocated.
 	Memsim_Init(); // Set up simulated physical memory system.
 	MMUOpenSwapFile(); // Open swap file for use.
+	Numa_Init(&options->numa); // Split physical memory into nodes.
 	PT_Init(); // Set up page table register value storage per process.
+	PT_SetDedup(options->dedup);
+	Policy_Init(options->policy); // Pick the page replacement policy.
+	if (options->policy == POLICY_OPT) {
+		// Look ahead at the whole input, and follow every online policy on the side
+		if (!Opt_Load()) {
+			printf("Error: could not read the input ahead for -r opt.\n");
+			return FALSE;
+		}
+		options->adaptive.enabled = TRUE;
+		options->adaptive.window = 100;
+		options->adaptive.margin = 0;
+		options->adaptive.policies = (1 << POLICY_COUNT) - 1;
+	}
+	Adaptive_Init(&options->adaptive);
+	Stats_Init(options->sampleInterval, options->tau, options->seriesPath);
+	Readahead_Init(options->readahead);
+	Zswap_Init(options->zswapBytes);
+	Tier_Init(&options->tier);
+	Cost_Init(&options->cost);
+	Pipeline_Init(&options->async);
+	for (int i = 0; i < options->numLimits; i++) {
+		int pid, hard, soft;
+		MMUParseLimit(options->limits[i], &pid, &hard, &soft);
+		Proc_SetLimits(pid, hard, soft);
+	}
+	// A checkpoint brings back its own memory, processes, policy state, limits, pool and far memory
+	for (int i = 0; i < options->numRestores; i++) {
+		if (!Checkpoint_Restore(options->restorePaths[i])) {
+			printf("Error: could not restore checkpoint %s.\n", options->restorePaths[i]);
+			return FALSE;
+		}
+	}
+	for (int i = 0; i < options->numPlacements; i++) {
+		int pid, policy, node;
+		Numa_ParsePolicy(options->placements[i], &pid, &policy, &node);
+		Proc_SetPlacement(pid, policy, node);
+	}
+	if (options->eventLogPath != NULL && !EventLog_Open(options->eventLogPath)) {
+		printf("Error: could not open %s for writing.\n", options->eventLogPath);
+		return FALSE;
+	}
+	if (options->lowWatermark > 0) {
+		Kswapd_Start(options->lowWatermark, options->highWatermark);
+	}
+	if (options->ksmInterval > 0) {
+		Ksm_Start(options->ksmInterval, options->ksmPages);
+	}
+	MMU_TLBFlushAll();
+	return TRUE;
 }
 
 int MMUStart() {
 	char* line;
 	while (TRUE) { // continue to read input until EOF
-		if (Input_GetLine(&line) < 1) { // allocate memory for each line
+		if (Input_GetLine(&line) < 1) { // the line buffer is reused for every line
 			printf("End of File.\n");
 			return 0;
 		} else {
+			MMU_LockMM();
 			Input_NextInstruction(line);
+			Kswapd_Poke();
+			Ksm_Poke();
+			MMU_UnlockMM();
 		}
-		free(line);
 	}
 }
 
@@ -45,6 +432,15 @@ FILE* MMU_GetSwapFileHandle() {
 	return swapFileHandle;
 }
 
+/* Takes exclusive use of the simulated memory, page tables and process table. */
+void MMU_LockMM() {
+	pthread_mutex_lock(&mmLock);
+}
+
+void MMU_UnlockMM() {
+	pthread_mutex_unlock(&mmLock);
+}
+
 /*
  * The most helpful function of an MMU. 
  * Translates the VPN to find the correct physical page, then adds the offset value.
@@ -54,11 +450,85 @@ FILE* MMU_GetSwapFileHandle() {
  * to find the exact location of the memory reference. If the page is not mapped, return -1.
 */
 int MMU_TranslateAddress(int process_id, int VPN, int offset){
-	int page;
-	if((page = PT_VPNtoPA(process_id, VPN)) != -1){
-		return page + offset;
-	} else {
-		return -1;
+	int pa = MMU_TranslateForAccess(process_id, PAGE_START(VPN) + offset, MMU_ACCESS_READ);
+	return pa < 0 ? -1 : pa;
+}
+
+/*
+ * Translates an address for a load or a store, checking it is allowed. Returns the
+ * physical address, or an MMU_FAULT_* code. Recent translations are cached in the TLB
+ * under the process's address space id. A load hitting the TLB, or a store hitting an
+ * entry a store filled, needs no walk. Otherwise the page table is walked once, which
+ * also sets the referenced and dirty bits. Addresses in far memory lie past PHYSICAL_SIZE.
+ */
+int MMU_TranslateForAccess(int process_id, int virtual_address, int access){
+	int VPN = VPN(virtual_address);
+	int asid = Proc_GetASID(Proc_Get(process_id));
+	TLBEntry* entry = &tlb[MMUTLBIndex(asid, VPN)];
+	int hit = entry->valid && entry->asid == asid && entry->vpn == VPN;
+	if (hit && (access == MMU_ACCESS_READ || entry->dirty)) {
+		Memsim_Pin(entry->pfn);
+		Policy_FrameAccessed(entry->pfn);
+		Adaptive_PageAccessed(process_id, VPN);
+		Numa_Access(process_id, entry->pfn);
+		Tier_CountAccess(TIER_ACCESS_DRAM);
+		Cost_Charge(COST_TLB_HIT);
+		return PAGE_START(entry->pfn) + PAGE_OFFSET(virtual_address);
+	}
+
+	if (!hit) {
+		EventLog_Record(EVENT_TLB_MISS, process_id, VPN, -1, -1, 0);
+	}
+	Cost_Charge(COST_WALK);
+	Adaptive_PageAccessed(process_id, FRAME_VPN_PAGETABLE);
+	int pfn = PT_TranslateForAccess(process_id, VPN, access);
+	if (pfn < 0) {
+		return pfn;
+	}
+	Adaptive_PageAccessed(process_id, VPN);
+	if (pfn >= NUM_FRAMES) { // Used in place in far memory, which is not cached
+		return PAGE_START(pfn) + PAGE_OFFSET(virtual_address);
+	}
+	entry->valid = 1;
+	entry->asid = asid;
+	entry->vpn = VPN;
+	entry->pfn = pfn;
+	entry->dirty = (access == MMU_ACCESS_WRITE);
+	Numa_Access(process_id, pfn);
+	return PAGE_START(pfn) + PAGE_OFFSET(virtual_address);
+}
+
+/* Drops the cached translation of one page, after its mapping changed. */
+void MMU_TLBInvalidate(int process_id, int VPN) {
+	Process* proc = Proc_Lookup(process_id);
+	if (proc == NULL) {
+		return;
+	}
+	TLBEntry* entry = &tlb[MMUTLBIndex(proc->asid, VPN)];
+	if (entry->asid == proc->asid && entry->vpn == VPN) {
+		entry->valid = 0;
+	}
+}
+
+/* Drops every cached translation of a process, e.g. when its page table is swapped out. */
+void MMU_TLBFlushPID(int process_id) {
+	Process* proc = Proc_Lookup(process_id);
+	if (proc != NULL) {
+		MMU_TLBFlushASID(proc->asid);
+	}
+}
+
+void MMU_TLBFlushASID(int asid) {
+	for (int i = 0; i < TLB_SIZE; i++) {
+		if (tlb[i].asid == asid) {
+			tlb[i].valid = 0;
+		}
+	}
+}
+
+void MMU_TLBFlushAll() {
+	for (int i = 0; i < TLB_SIZE; i++) {
+		tlb[i].valid = 0;
 	}
 }
 
@@ -66,9 +536,37 @@ int MMU_TranslateAddress(int process_id, int VPN, int offset){
  * Main start of simulation of the MMU.
  * Initializes MMU and starts receiving input and executing instructions.
  */
-int main () {
+int main (int argc, char* argv[]) {
+	MMUOptions options;
+	if (!MMUParseArgs(argc, argv, &options)) {
+		MMUFreeOptions(&options);
+		MMUUsage(argv[0]);
+		return 1;
+	}
 	/* Setup free page tracking, page table location register storage (per process), and open swap file. */
-	MMUInit(); 
+	int initialized = MMUInit(&options);
+	MMUFreeOptions(&options);
+	if (!initialized) {
+		return 1;
+	}
+	if (options.compactPath != NULL) {
+		if (!Checkpoint_Save(options.compactPath)) {
+			printf("Error: could not write checkpoint to %s.\n", options.compactPath);
+			return 1;
+		}
+		printf("Saved checkpoint to %s.\n", options.compactPath);
+		return 0;
+	}
 	/* Begin reading instructions and completing requested operations. Loops continuously. Returns when finished. */
-	return MMUStart();
+	Arena_SetupDone();
+	int result = options.generate ? Workload_Run(&options.workload)
+		: options.async.enabled ? Pipeline_Run() : MMUStart();
+	Kswapd_Stop();
+	Ksm_Stop();
+	if (options.report) {
+		Stats_Report();
+	}
+	EventLog_Close();
+	Stats_Close();
+	return result;
 }
\ No newline at end of file
@@ -10,7 +10,23 @@
 #define TRUE 1
 #define FALSE 0
 
+// Kinds of access checked by MMU_TranslateForAccess
+#define MMU_ACCESS_READ 0
+#define MMU_ACCESS_WRITE 1
+
+// Faults returned instead of a physical address, all negative
+#define MMU_FAULT_NOT_MAPPED -1   // No valid entry for the page
+#define MMU_FAULT_PROTECTION -2   // A store to a page mapped read-only
+#define MMU_FAULT_NOT_PRESENT -3  // No frame could be found for the page (or its page table or private copy)
+
 FILE* MMU_GetSwapFileHandle();
+void MMU_LockMM();
+void MMU_UnlockMM();
 int MMU_TranslateAddress(int process_id, int VPN, int offset);
+int MMU_TranslateForAccess(int process_id, int virtual_address, int access);
+void MMU_TLBInvalidate(int process_id, int VPN);
+void MMU_TLBFlushPID(int process_id);
+void MMU_TLBFlushASID(int asid);
+void MMU_TLBFlushAll();
 
 #endif // PROJECT3_H
\ No newline at end of file
@@ -0,0 +1,206 @@
+/*
+ * Aggregates an event log written by `mmu -e file` into a fault timeline and per page
+ * heat. Standalone, it only shares the record layout with the simulator.
+ *
+ * Usage: mmutrace [-b instructions] [-n pages] [file]
+ *   file  event log, read from stdin if not given
+ *   -b  width of a timeline bucket in instructions (default 10)
+ *   -n  pages listed by heat (default 20)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "eventlog.h"
+
+#define NUM_EVENT_TYPES 6
+
+const char* eventNames[NUM_EVENT_TYPES] = { "", "tlb misses", "faults", "swap-ins", "evictions", "prefetches" };
+
+/* Event counts of one page (vpn -1: the page table) of one process. */
+typedef struct {
+    int pid;
+    int vpn;
+    long counts[NUM_EVENT_TYPES];
+} PageHeat;
+
+/* Event counts of one process in one timeline bucket. */
+typedef struct {
+    long bucket;
+    int pid;
+    long counts[NUM_EVENT_TYPES];
+} TimelineRow;
+
+// Open addressing table of pages keyed by pid and vpn, grown at half load
+PageHeat* pages = NULL;
+size_t pageCapacity = 0;
+size_t numPages = 0;
+
+// Timeline rows, in log order. Records are in instruction order, so a new bucket
+// never reopens an older one and only the rows of the current bucket are searched.
+TimelineRow* rows = NULL;
+size_t numRows = 0;
+size_t rowCapacity = 0;
+size_t bucketStartRow = 0;
+
+long totals[NUM_EVENT_TYPES];
+
+size_t PageHash(int pid, int vpn) {
+    return ((size_t)pid * 2654435761u) ^ ((size_t)(vpn + 1) * 40503u);
+}
+
+PageHeat* PageFind(int pid, int vpn);
+
+void PagesGrow() {
+    PageHeat* old = pages;
+    size_t oldCapacity = pageCapacity;
+    pageCapacity = oldCapacity ? oldCapacity * 2 : 1024;
+    pages = malloc(pageCapacity * sizeof(PageHeat));
+    for (size_t i = 0; i < pageCapacity; i++) {
+        pages[i].pid = -1;
+    }
+    numPages = 0;
+    for (size_t i = 0; i < oldCapacity; i++) {
+        if (old[i].pid != -1) {
+            *PageFind(old[i].pid, old[i].vpn) = old[i];
+        }
+    }
+    free(old);
+}
+
+/* Finds the entry of a page, adding it if new. Empty slots have pid -1. */
+PageHeat* PageFind(int pid, int vpn) {
+    if (2 * (numPages + 1) > pageCapacity) {
+        PagesGrow();
+    }
+    size_t i = PageHash(pid, vpn) & (pageCapacity - 1);
+    while (pages[i].pid != -1 && (pages[i].pid != pid || pages[i].vpn != vpn)) {
+        i = (i + 1) & (pageCapacity - 1);
+    }
+    if (pages[i].pid == -1) {
+        memset(&pages[i], 0, sizeof(PageHeat));
+        pages[i].pid = pid;
+        pages[i].vpn = vpn;
+        numPages++;
+    }
+    return &pages[i];
+}
+
+TimelineRow* RowFind(long bucket, int pid) {
+    if (numRows > bucketStartRow && rows[numRows - 1].bucket != bucket) {
+        bucketStartRow = numRows;
+    }
+    for (size_t i = bucketStartRow; i < numRows; i++) {
+        if (rows[i].pid == pid) {
+            return &rows[i];
+        }
+    }
+    if (numRows == rowCapacity) {
+        rowCapacity = rowCapacity ? rowCapacity * 2 : 256;
+        rows = realloc(rows, rowCapacity * sizeof(TimelineRow));
+    }
+    TimelineRow* row = &rows[numRows++];
+    memset(row, 0, sizeof(TimelineRow));
+    row->bucket = bucket;
+    row->pid = pid;
+    return row;
+}
+
+long PageTotal(const PageHeat* page) {
+    return page->counts[EVENT_FAULT] + page->counts[EVENT_EVICT] + page->counts[EVENT_PREFETCH];
+}
+
+int PageCompareHeat(const void* a, const void* b) {
+    const PageHeat* pa = a;
+    const PageHeat* pb = b;
+    long ta = PageTotal(pa), tb = PageTotal(pb);
+    if (ta != tb) {
+        return ta > tb ? -1 : 1;
+    }
+    if (pa->pid != pb->pid) {
+        return pa->pid - pb->pid;
+    }
+    return pa->vpn - pb->vpn;
+}
+
+int main(int argc, char* argv[]) {
+    long bucketWidth = 10;
+    int topPages = 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:n:")) != -1) {
+        if (opt == 'b') {
+            bucketWidth = atol(optarg);
+        } else if (opt == 'n') {
+            topPages = atoi(optarg);
+        } else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (optind < argc - 1 || bucketWidth < 1) {
+        printf("Usage: %s [-b instructions] [-n pages] [file]\n", argv[0]);
+        return 1;
+    }
+
+    const char* path = (optind < argc) ? argv[optind] : "stdin";
+    FILE* file = (optind < argc) ? fopen(path, "rb") : stdin;
+    EventLogHeader header;
+    if (file == NULL || fread(&header, sizeof(header), 1, file) != 1
+        || memcmp(header.magic, EVENTLOG_MAGIC, sizeof(EVENTLOG_MAGIC)) != 0
+        || header.version != EVENTLOG_VERSION || header.recordSize != sizeof(EventRecord)) {
+        printf("Error: %s is not an event log.\n", path);
+        return 1;
+    }
+
+    PagesGrow();
+    EventRecord record;
+    long lastInstruction = 0;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.type == 0 || record.type >= NUM_EVENT_TYPES) {
+            continue;
+        }
+        totals[record.type]++;
+        PageFind(record.pid, record.vpn)->counts[record.type]++;
+        RowFind(record.instruction / bucketWidth, record.pid)->counts[record.type]++;
+        lastInstruction = record.instruction;
+    }
+    fclose(file);
+
+    long events = 0;
+    for (int type = 1; type < NUM_EVENT_TYPES; type++) {
+        events += totals[type];
+    }
+    printf("Events: %ld up to instruction %ld (page size %u, %u frames)\n",
+           events, lastInstruction, header.pageSize, header.numFrames);
+    for (int type = 1; type < NUM_EVENT_TYPES; type++) {
+        printf("  %s: %ld\n", eventNames[type], totals[type]);
+    }
+
+    printf("Fault timeline, per %ld instructions:\n", bucketWidth);
+    printf("instruction,pid,faults,swap_ins,evictions,prefetches,tlb_misses\n");
+    for (size_t i = 0; i < numRows; i++) {
+        long* counts = rows[i].counts;
+        printf("%ld,%d,%ld,%ld,%ld,%ld,%ld\n", rows[i].bucket * bucketWidth, rows[i].pid,
+               counts[EVENT_FAULT], counts[EVENT_SWAP_IN], counts[EVENT_EVICT],
+               counts[EVENT_PREFETCH], counts[EVENT_TLB_MISS]);
+    }
+
+    // Compact the table and rank pages by how often they moved in or out of memory
+    size_t count = 0;
+    for (size_t i = 0; i < pageCapacity; i++) {
+        if (pages[i].pid != -1) {
+            pages[count++] = pages[i];
+        }
+    }
+    qsort(pages, count, sizeof(PageHeat), PageCompareHeat);
+    printf("Page heat, top %d by faults, evictions and prefetches (vpn -1: page table):\n", topPages);
+    printf("pid,vpn,faults,evictions,prefetches,tlb_misses\n");
+    for (size_t i = 0; i < count && i < (size_t)topPages; i++) {
+        long* counts = pages[i].counts;
+        printf("%d,%d,%ld,%ld,%ld,%ld\n", pages[i].pid, pages[i].vpn, counts[EVENT_FAULT],
+               counts[EVENT_EVICT], counts[EVENT_PREFETCH], counts[EVENT_TLB_MISS]);
+    }
+    return 0;
+}
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "numa.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "pagetable.h"
+#include "process.h"
+
+/* Private Internals: */
+
+int numaNodes = 1;
+int distance[NUMA_MAX_NODES][NUMA_MAX_NODES];
+int migrateThreshold = 0;
+
+// Nodes in the order frames are taken from them, nearest first, for each starting node
+int fallback[NUMA_MAX_NODES][NUMA_MAX_NODES];
+
+// Frames that just reached the migration threshold, moved once the instruction completes.
+// A frame is queued when its count reaches the threshold, so at most once between drains.
+int candidates[NUM_FRAMES];
+int numCandidates = 0;
+
+long migrations = 0;
+long failedMigrations = 0;  // Nothing on the owner's node could be evicted, or its page table was out
+long migrationCost = 0;
+
+/* Orders the nodes by distance from each node, keeping node order among equals. */
+void NumaBuildFallback() {
+    for (int from = 0; from < numaNodes; from++) {
+        int* order = fallback[from];
+        for (int i = 0; i < numaNodes; i++) {
+            int node = i, j = i;
+            while (j > 0 && distance[from][order[j - 1]] > distance[from][node]) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = node;
+        }
+    }
+}
+
+/* Whether a frame still holds a private page worth moving to its owner's node. */
+int NumaMigratable(int pfn) {
+    FrameInfo* info = Memsim_GetFrameInfo(pfn);
+    return Memsim_FrameInUse(pfn) && info->vpn >= 0 && info->mapCount == 0
+        && info->remoteAccesses >= migrateThreshold
+        && Memsim_NodeOf(pfn) != Numa_HomeNode(info->pid);
+}
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Reads a node layout from a comma separated key=value list:
+ *   nodes=count distance=d00/d01/.../dnn migrate=remote-accesses
+ * The distance matrix has nodes*nodes entries, row by row, and defaults to
+ * NUMA_LOCAL_DISTANCE within a node and NUMA_REMOTE_DISTANCE between nodes.
+ * Returns FALSE (after printing why) if it is invalid.
+ */
+int Numa_Parse(const char* spec, NumaSpec* out) {
+    out->nodes = 1;
+    out->migrateThreshold = 8;
+    char* distances = NULL;
+
+    char* copy = strdup(spec);
+    int ok = TRUE;
+    for (char* item = strtok(copy, ","); item != NULL && ok; item = strtok(NULL, ",")) {
+        char* value = strchr(item, '=');
+        if (value == NULL) {
+            ok = FALSE;
+            break;
+        }
+        *value++ = '\0';
+        if (strcmp(item, "nodes") == 0) {
+            out->nodes = atoi(value);
+        } else if (strcmp(item, "distance") == 0) {
+            distances = value;
+        } else if (strcmp(item, "migrate") == 0) {
+            out->migrateThreshold = atoi(value);
+        } else {
+            ok = FALSE;
+        }
+    }
+    int maxNodes = NUM_FRAMES < NUMA_MAX_NODES ? NUM_FRAMES : NUMA_MAX_NODES;
+    ok = ok && out->nodes >= 1 && out->nodes <= maxNodes && out->migrateThreshold >= 0;
+
+    for (int i = 0; ok && i < out->nodes; i++) {
+        for (int j = 0; j < out->nodes; j++) {
+            out->distance[i][j] = (i == j) ? NUMA_LOCAL_DISTANCE : NUMA_REMOTE_DISTANCE;
+        }
+    }
+    for (int k = 0; ok && distances != NULL && k < out->nodes * out->nodes; k++) {
+        char* end;
+        int d = (int)strtol(distances, &end, 10);
+        ok = end != distances && d > 0 && (*end == '/' || (*end == '\0' && k == out->nodes * out->nodes - 1));
+        out->distance[k / out->nodes][k % out->nodes] = d;
+        distances = end + 1;
+    }
+    free(copy);
+
+    if (!ok) {
+        printf("Invalid NUMA layout '%s'. Use key=value pairs among nodes (1-%d), " \
+               "distance=d/d/... (nodes*nodes values) and migrate (remote accesses, 0 never).\n",
+               spec, maxNodes);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Parses a -P pid:local, pid:interleave or pid:preferred:node placement. pid * (returned
+ * as -1) applies to every process. Returns FALSE if it is malformed.
+ */
+int Numa_ParsePolicy(const char* arg, int* pidOut, int* policyOut, int* nodeOut) {
+    const char* colon = strchr(arg, ':');
+    if (colon == NULL) {
+        return FALSE;
+    }
+    if (arg[0] == '*' && colon == arg + 1) {
+        *pidOut = -1;
+    } else if (sscanf(arg, "%d", pidOut) != 1 || *pidOut < 0 || *pidOut > MAX_PID) {
+        return FALSE;
+    }
+    const char* policy = colon + 1;
+    *nodeOut = 0;
+    if (strcmp(policy, "local") == 0) {
+        *policyOut = NUMA_POLICY_LOCAL;
+    } else if (strcmp(policy, "interleave") == 0) {
+        *policyOut = NUMA_POLICY_INTERLEAVE;
+    } else if (sscanf(policy, "preferred:%d", nodeOut) == 1 && *nodeOut >= 0) {
+        *policyOut = NUMA_POLICY_PREFERRED;
+    } else {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Splits physical memory into the nodes of a layout. One node turns NUMA off. */
+void Numa_Init(const NumaSpec* spec) {
+    numaNodes = spec->nodes;
+    memcpy(distance, spec->distance, sizeof(distance));
+    migrateThreshold = spec->migrateThreshold;
+    numCandidates = 0;
+    migrations = 0;
+    failedMigrations = 0;
+    migrationCost = 0;
+    Memsim_SetNodes(numaNodes);
+    NumaBuildFallback();
+}
+
+int Numa_Enabled() {
+    return numaNodes > 1;
+}
+
+/* Node whose CPUs a process runs on. */
+int Numa_HomeNode(int pid) {
+    return pid % numaNodes;
+}
+
+/*
+ * Claims a free frame for a process following its placement policy: from the first
+ * node the policy picks, or else from the nodes nearest to it. Returns -1 if memory is full.
+ */
+int Numa_AllocFrame(int pid) {
+    if (!Numa_Enabled()) {
+        return Memsim_FirstFreePFN();
+    }
+    Process* proc = Proc_Get(pid);
+    int first = Numa_HomeNode(pid);
+    if (proc->numaPolicy == NUMA_POLICY_PREFERRED) {
+        first = proc->numaNode;
+    } else if (proc->numaPolicy == NUMA_POLICY_INTERLEAVE) {
+        first = proc->numaNext;
+        proc->numaNext = (first + 1) % numaNodes;
+    }
+    for (int i = 0; i < numaNodes; i++) {
+        int pfn = Memsim_AllocFrameOnNode(fallback[first][i]);
+        if (pfn != -1) {
+            return pfn;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Accounts a load or store by a process to a frame as local or remote, at the distance
+ * between their nodes. A private page that keeps being accessed from another node is
+ * queued to move to its owner's node.
+ */
+void Numa_Access(int pid, int pfn) {
+    if (!Numa_Enabled()) {
+        return;
+    }
+    ProcStats* stats = &Proc_Get(pid)->stats;
+    int home = Numa_HomeNode(pid);
+    int node = Memsim_NodeOf(pfn);
+    stats->accessCost += distance[home][node];
+    if (node == home) {
+        stats->localAccesses++;
+        return;
+    }
+    stats->remoteAccesses++;
+
+    FrameInfo* info = Memsim_GetFrameInfo(pfn);
+    if (migrateThreshold > 0 && info->pid == pid && info->vpn >= 0 && info->mapCount == 0
+        && ++info->remoteAccesses == migrateThreshold && numCandidates < NUM_FRAMES) {
+        candidates[numCandidates++] = pfn;
+    }
+}
+
+/*
+ * Migrates the pages queued during the instruction, now that nothing is pinned. Copying
+ * a page is modeled as an access per byte at the distance it travels.
+ */
+void Numa_InstructionDone() {
+    if (numCandidates == 0) {
+        return;
+    }
+    for (int i = 0; i < numCandidates; i++) {
+        int pfn = candidates[i];
+        if (!NumaMigratable(pfn)) {
+            continue;
+        }
+        FrameInfo* info = Memsim_GetFrameInfo(pfn);
+        int pid = info->pid;
+        int vpn = info->vpn;
+        int from = Memsim_NodeOf(pfn);
+        int to = Numa_HomeNode(pid);
+        int target = PT_MigratePage(pfn, to);
+        if (target == -1) {
+            info->remoteAccesses = 0; // try again after as many remote accesses
+            failedMigrations++;
+            continue;
+        }
+        migrations++;
+        migrationCost += (long)PAGE_SIZE * distance[from][to];
+        printf("Migrated page %d of PID %d from frame %d (node %d) to frame %d (node %d).\n",
+               vpn, pid, pfn, from, target, to);
+    }
+    numCandidates = 0;
+    Memsim_UnpinAll();
+}
+
+void Numa_Report() {
+    if (!Numa_Enabled()) {
+        return;
+    }
+    printf("NUMA: %d nodes, migrations %ld (modeled cost %ld), failed migrations %ld\n",
+           numaNodes, migrations, migrationCost, failedMigrations);
+    for (int node = 0; node < numaNodes; node++) {
+        printf("Node %d: frames %d-%d, free %d, distances", node, Memsim_NodeStart(node),
+               Memsim_NodeStart(node + 1) - 1, Memsim_NodeFreeFrames(node));
+        for (int j = 0; j < numaNodes; j++) {
+            printf(" %d", distance[node][j]);
+        }
+        printf("\n");
+    }
+}
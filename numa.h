@@ -0,0 +1,36 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+/*
+ * Public Interface:
+ */
+
+#define NUMA_MAX_NODES 8
+
+// Distances, in the ACPI SLIT convention where 10 is a local access
+#define NUMA_LOCAL_DISTANCE 10
+#define NUMA_REMOTE_DISTANCE 20
+
+// Where the frames of a process are allocated
+#define NUMA_POLICY_LOCAL 0       // The node the process runs on (pid modulo nodes)
+#define NUMA_POLICY_INTERLEAVE 1  // Every node in turn
+#define NUMA_POLICY_PREFERRED 2   // A chosen node
+
+/* Node layout and migration settings, from a --numa key=value list. */
+typedef struct {
+    int nodes;
+    int distance[NUMA_MAX_NODES][NUMA_MAX_NODES];
+    int migrateThreshold;  // Remote accesses to a page before it moves to its owner's node (0: never)
+} NumaSpec;
+
+int Numa_Parse(const char* spec, NumaSpec* out);
+int Numa_ParsePolicy(const char* arg, int* pidOut, int* policyOut, int* nodeOut);
+void Numa_Init(const NumaSpec* spec);
+int Numa_Enabled();
+int Numa_HomeNode(int pid);
+int Numa_AllocFrame(int pid);
+void Numa_Access(int pid, int pfn);
+void Numa_InstructionDone();
+void Numa_Report();
+
+#endif // NUMA_H
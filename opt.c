@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "opt.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "input.h"
+#include "process.h"
+#include "policy.h"
+
+/* Private Internals: */
+
+// Belady's optimal replacement: evict the page whose next use is furthest in the future.
+// The whole input is read (mapped if it is a file) before the first instruction, every
+// reference of every line is listed, and each reference is chained to the next reference
+// to the same page. Executing a line moves the per-page cursors along those chains.
+
+// Pages are numbered as the ghost caches number them, a page table being page -1
+#define OPT_KEYS ((MAX_PID + 1) * (VPN(VIRTUAL_SIZE) + 1))
+
+int optEnabled = FALSE;
+
+const char* optTrace = NULL;
+size_t optTraceSize = 0;
+size_t optOffset = 0;        // Start of the next line in the trace
+
+int optNumLines = 0;
+int optLine = 0;             // Index of the next line to execute
+int* optLineFirst = NULL;    // First reference of each line, and one past the last
+
+int optNumRefs = 0;
+int* optRefKey = NULL;
+int* optRefLine = NULL;
+int* optRefNext = NULL;      // Next reference to the same page, or -1
+
+int* optCursor = NULL;       // Next reference to each page, or -1
+int* optKeyFrame = NULL;     // Frame last seen holding each page
+
+// Max-heap of (next use, frame). Entries go stale when a frame's next use moves or its
+// page leaves, and are dropped when they surface; every frame that may be evicted has an
+// entry with its current next use, pushed whenever that changes.
+int* optHeapUse = NULL;
+int* optHeapPfn = NULL;
+int optHeapSize = 0;
+int optRebuildPending = TRUE;
+
+// Entries the heap may hold, stale ones included, before it is rebuilt from the frames.
+// A push past the limit rebuilds first, so the heap never holds more than one over it.
+#define OPT_HEAP_LIMIT (4 * NUM_FRAMES + 64)
+#define OPT_HEAP_CAPACITY (OPT_HEAP_LIMIT + 1)
+
+// Valid entries set aside while looking for a victim the filter accepts
+int* optAsideUse = NULL;
+int* optAsidePfn = NULL;
+
+int OptKey(int pid, int vpn) {
+    return pid * (VPN(VIRTUAL_SIZE) + 1) + vpn + 1;
+}
+
+/* Page held by a frame that may ever be evicted, or -1 (free or shared). */
+int OptFrameKey(int pfn) {
+    FrameInfo* info = Memsim_GetFrameInfo(pfn);
+    if (!Memsim_FrameInUse(pfn) || info->pid < 0 || info->pid > MAX_PID
+        || (info->vpn < 0 && info->vpn != FRAME_VPN_PAGETABLE)) {
+        return -1;
+    }
+    return OptKey(info->pid, info->vpn);
+}
+
+int OptKeyNextUse(int key) {
+    int ref = optCursor[key];
+    return (ref == -1) ? INT_MAX : optRefLine[ref];
+}
+
+/* Reads all of stdin, mapping it when it is a regular file. */
+int OptReadTrace() {
+    struct stat st;
+    if (fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+        if (map != MAP_FAILED) {
+            optTrace = map;
+            optTraceSize = st.st_size;
+            return TRUE;
+        }
+    }
+    size_t capacity = 1 << 16;
+    char* buffer = malloc(capacity);
+    size_t got;
+    while (buffer != NULL && (got = fread(buffer + optTraceSize, 1, capacity - optTraceSize, stdin)) > 0) {
+        optTraceSize += got;
+        if (optTraceSize == capacity) {
+            buffer = realloc(buffer, capacity *= 2);
+        }
+    }
+    optTrace = buffer;
+    return buffer != NULL;
+}
+
+/* End of the line starting at offset, past its newline. */
+size_t OptLineEnd(size_t offset) {
+    const char* newline = memchr(optTrace + offset, '\n', optTraceSize - offset);
+    return (newline == NULL) ? optTraceSize : (size_t)(newline - optTrace) + 1;
+}
+
+void OptAddRef(int key, int line) {
+    for (int ref = optLineFirst[line]; ref < optNumRefs; ref++) {
+        if (optRefKey[ref] == key) {
+            return;
+        }
+    }
+    optRefKey[optNumRefs] = key;
+    optRefLine[optNumRefs] = line;
+    optNumRefs++;
+}
+
+/*
+ * Lists the references of a line the way Input_NextInstruction will run it: its page
+ * table, then the pages it loads, stores, maps or copies. Lines that are not instructions
+ * (checkpoints, malformed lines) reference nothing.
+ */
+void OptScanLine(const char* text, int line) {
+    int pid, vpns[VPN(VIRTUAL_SIZE)];
+    int count = Input_LinePages(text, &pid, vpns);
+    if (count == -1) {
+        return;
+    }
+    OptAddRef(OptKey(pid, FRAME_VPN_PAGETABLE), line);
+    for (int i = 0; i < count; i++) {
+        OptAddRef(OptKey(pid, vpns[i]), line);
+    }
+}
+
+void OptRebuild();
+
+/* Orders the heap by next use, then by frame so that the victim never depends on its history. */
+int OptHeapAbove(int i, int use, int pfn) {
+    return optHeapUse[i] > use || (optHeapUse[i] == use && optHeapPfn[i] > pfn);
+}
+
+void OptHeapPush(int use, int pfn) {
+    if (optHeapSize > OPT_HEAP_LIMIT) {
+        OptRebuild(); // Frames are pushed far more often than they are evicted
+    }
+    int i = optHeapSize++;
+    while (i > 0 && !OptHeapAbove((i - 1) / 2, use, pfn)) {
+        optHeapUse[i] = optHeapUse[(i - 1) / 2];
+        optHeapPfn[i] = optHeapPfn[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    optHeapUse[i] = use;
+    optHeapPfn[i] = pfn;
+}
+
+void OptHeapPop() {
+    int use = optHeapUse[--optHeapSize];
+    int pfn = optHeapPfn[optHeapSize];
+    int i = 0;
+    for (int child = 1; child < optHeapSize; child = 2 * i + 1) {
+        if (child + 1 < optHeapSize && OptHeapAbove(child + 1, optHeapUse[child], optHeapPfn[child])) {
+            child++;
+        }
+        if (!OptHeapAbove(child, use, pfn)) {
+            break;
+        }
+        optHeapUse[i] = optHeapUse[child];
+        optHeapPfn[i] = optHeapPfn[child];
+        i = child;
+    }
+    optHeapUse[i] = use;
+    optHeapPfn[i] = pfn;
+}
+
+/* Pushes the current next use of the page a frame holds. */
+void OptPushFrame(int pfn) {
+    int key = OptFrameKey(pfn);
+    if (key != -1) {
+        optKeyFrame[key] = pfn;
+        OptHeapPush(OptKeyNextUse(key), pfn);
+    }
+}
+
+/* Drops every stale entry by pushing each frame afresh. */
+void OptRebuild() {
+    optHeapSize = 0;
+    for (int pfn = 0; pfn < NUM_FRAMES; pfn++) {
+        OptPushFrame(pfn);
+    }
+    optRebuildPending = FALSE;
+}
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Reads the whole input ahead of the simulation and chains the references to each page.
+ * Every array is sized from the trace up front, so running it allocates nothing.
+ * Returns FALSE if the input cannot be read.
+ */
+int Opt_Load() {
+    if (!OptReadTrace()) {
+        return FALSE;
+    }
+    int lines = 0;
+    for (size_t offset = 0; offset < optTraceSize; offset = OptLineEnd(offset)) {
+        lines++;
+    }
+    // A line references its page table and at most every page of its process
+    int maxRefs = lines * (VPN(VIRTUAL_SIZE) + 1);
+    optLineFirst = malloc((lines + 1) * sizeof(int));
+    optRefKey = malloc((maxRefs > 0 ? maxRefs : 1) * sizeof(int));
+    optRefLine = malloc((maxRefs > 0 ? maxRefs : 1) * sizeof(int));
+    optHeapUse = malloc(OPT_HEAP_CAPACITY * sizeof(int));
+    optHeapPfn = malloc(OPT_HEAP_CAPACITY * sizeof(int));
+    optAsideUse = malloc(OPT_HEAP_CAPACITY * sizeof(int));
+    optAsidePfn = malloc(OPT_HEAP_CAPACITY * sizeof(int));
+
+    char text[MAX_GETLINE_CHARS];
+    for (size_t offset = 0; offset < optTraceSize; offset = OptLineEnd(offset)) {
+        optLineFirst[optNumLines] = optNumRefs;
+        // Only the part of a long line Input_GetLine keeps is an instruction
+        size_t length = OptLineEnd(offset) - offset;
+        length = (length < MAX_GETLINE_CHARS - 1) ? length : MAX_GETLINE_CHARS - 1;
+        memcpy(text, optTrace + offset, length);
+        text[length] = '\0';
+        OptScanLine(text, optNumLines);
+        optNumLines++;
+    }
+    optLineFirst[optNumLines] = optNumRefs;
+
+    optRefNext = malloc((optNumRefs > 0 ? optNumRefs : 1) * sizeof(int));
+    optCursor = malloc(OPT_KEYS * sizeof(int));
+    optKeyFrame = malloc(OPT_KEYS * sizeof(int));
+    memset(optCursor, -1, OPT_KEYS * sizeof(int));
+    memset(optKeyFrame, -1, OPT_KEYS * sizeof(int));
+    for (int ref = optNumRefs - 1; ref >= 0; ref--) {
+        optRefNext[ref] = optCursor[optRefKey[ref]];
+        optCursor[optRefKey[ref]] = ref;
+    }
+    optEnabled = TRUE;
+    optRebuildPending = TRUE;
+    return TRUE;
+}
+
+int Opt_Enabled() {
+    return optEnabled;
+}
+
+/*
+ * Copies the next line of the loaded input into out the way fgets would, at most max - 1
+ * bytes of it, and moves the pages it references on to their next use.
+ * Returns its length, or -1 at the end of the input.
+ */
+int Opt_NextLine(char* out, int max) {
+    if (optOffset >= optTraceSize) {
+        return -1;
+    }
+    size_t end = OptLineEnd(optOffset);
+    size_t length = (end - optOffset < (size_t)max - 1) ? end - optOffset : (size_t)max - 1;
+    memcpy(out, optTrace + optOffset, length);
+    out[length] = '\0';
+    optOffset = end;
+
+    for (int ref = optLineFirst[optLine]; ref < optLineFirst[optLine + 1]; ref++) {
+        int key = optRefKey[ref];
+        optCursor[key] = optRefNext[ref];
+        int pfn = optKeyFrame[key];
+        if (pfn != -1 && OptFrameKey(pfn) == key) {
+            OptHeapPush(OptKeyNextUse(key), pfn);
+        }
+    }
+    optLine++;
+    return (int)length;
+}
+
+/* Index of the next line referencing a page (or with vpn -1 a page table), INT_MAX if none. */
+int Opt_NextUse(int pid, int vpn) {
+    return optEnabled ? OptKeyNextUse(OptKey(pid, vpn)) : INT_MAX;
+}
+
+/* Records which page a frame holds now and when it is used next. */
+void Opt_FrameAccessed(int pfn) {
+    if (optEnabled) {
+        OptPushFrame(pfn);
+    }
+}
+
+/*
+ * Chooses the frame accepted by the filter whose page is used furthest in the future.
+ * Returns -1 if every eligible frame is pinned.
+ */
+int Opt_SelectVictim(PolicyFilter filter, int arg) {
+    int rebuilt = optRebuildPending;
+    if (rebuilt) {
+        OptRebuild();
+    }
+    int victim = -1, aside = 0;
+    while (optHeapSize > 0 && victim == -1) {
+        int use = optHeapUse[0], pfn = optHeapPfn[0];
+        OptHeapPop();
+        int key = OptFrameKey(pfn);
+        if (key == -1 || OptKeyNextUse(key) != use) {
+            continue;
+        }
+        optAsideUse[aside] = use;
+        optAsidePfn[aside++] = pfn;
+        if (Memsim_NextEvictable(pfn) == pfn && (filter == NULL || filter(pfn, arg))) {
+            victim = pfn;
+        }
+    }
+    // The victim's entry goes back too, in case it is not evicted after all
+    while (aside > 0) {
+        aside--;
+        OptHeapPush(optAsideUse[aside], optAsidePfn[aside]);
+    }
+    if (victim == -1 && !rebuilt) {
+        // A frame filled behind the policy's back (e.g. restored) has no entry yet
+        optRebuildPending = TRUE;
+        return Opt_SelectVictim(filter, arg);
+    }
+    return victim;
+}
@@ -0,0 +1,17 @@
+#ifndef OPT_H
+#define OPT_H
+
+#include "policy.h"
+
+/*
+ * Public Interface:
+ */
+
+int Opt_Load();
+int Opt_Enabled();
+int Opt_NextLine(char* out, int max);
+int Opt_NextUse(int pid, int vpn);
+void Opt_FrameAccessed(int pfn);
+int Opt_SelectVictim(PolicyFilter filter, int arg);
+
+#endif // OPT_H
@@ -0,0 +1,437 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "pageops.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PAGEOPS_X86 1
+#include <immintrin.h>
+#endif
+
+/* Private Internals: */
+
+/*
+ * The checksum keeps two sums per 32-bit lane over 32-byte blocks, Fletcher style:
+ * A[j] += word[j], then B[j] += A[j]. B makes it depend on the order of the blocks.
+ * A partial last block is padded with zeros, and the lanes are mixed into 64 bits at the end.
+ */
+#define CHECKSUM_LANES 8
+#define CHECKSUM_BLOCK (CHECKSUM_LANES * 4)
+
+typedef struct {
+    const char* name;
+    void (*zero)(char* dst, int len);
+    void (*zeroStream)(char* dst, int len);
+    void (*copy)(char* dst, const char* src, int len);
+    void (*copyStream)(char* dst, const char* src, int len);
+    int (*equal)(const char* a, const char* b, int len);
+    int (*isZero)(const char* src, int len);
+    void (*checksumBlocks)(const char* src, int blocks, uint32_t* a, uint32_t* b);
+} PageOpsKernels;
+
+// CRC32C (Castagnoli), reflected polynomial
+#define CRC32C_POLY 0x82F63B78u
+
+uint32_t crc32cTable[256];
+
+// Copy and CRC32C kernel, using the SSE4.2 crc32 instruction when the CPU has it
+uint32_t (*copyCRC32C)(char* dst, const char* src, int len, uint32_t crc);
+
+/* Scalar kernels, a 64-bit word at a time. */
+
+void PageOpsZeroScalar(char* dst, int len) {
+    uint64_t zero = 0;
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        memcpy(&dst[i], &zero, 8);
+    }
+    for (; i < len; i++) {
+        dst[i] = 0;
+    }
+}
+
+void PageOpsCopyScalar(char* dst, const char* src, int len) {
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, &src[i], 8);
+        memcpy(&dst[i], &word, 8);
+    }
+    for (; i < len; i++) {
+        dst[i] = src[i];
+    }
+}
+
+int PageOpsEqualScalar(const char* a, const char* b, int len) {
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, &a[i], 8);
+        memcpy(&y, &b[i], 8);
+        if (x != y) {
+            return 0;
+        }
+    }
+    for (; i < len; i++) {
+        if (a[i] != b[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int PageOpsIsZeroScalar(const char* src, int len) {
+    uint64_t bits = 0;
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, &src[i], 8);
+        bits |= word;
+    }
+    for (; i < len; i++) {
+        bits |= (unsigned char)src[i];
+    }
+    return bits == 0;
+}
+
+void PageOpsChecksumBlocksScalar(const char* src, int blocks, uint32_t* a, uint32_t* b) {
+    for (int i = 0; i < blocks; i++, src += CHECKSUM_BLOCK) {
+        for (int j = 0; j < CHECKSUM_LANES; j++) {
+            uint32_t word;
+            memcpy(&word, &src[j * 4], 4);
+            a[j] += word;
+            b[j] += a[j];
+        }
+    }
+}
+
+uint32_t PageOpsCopyCRC32CScalar(char* dst, const char* src, int len, uint32_t crc) {
+    for (int i = 0; i < len; i++) {
+        dst[i] = src[i];
+        crc = crc32cTable[(crc ^ (unsigned char)src[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+void PageOpsInitCRC32C() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        crc32cTable[i] = crc;
+    }
+}
+
+#ifdef PAGEOPS_X86
+
+/* Hardware CRC32C, each word is checksummed as it passes through a register on its way to dst. */
+__attribute__((target("sse4.2")))
+uint32_t PageOpsCopyCRC32CHardware(char* dst, const char* src, int len, uint32_t crc) {
+    int i = 0;
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, &src[i], 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        memcpy(&dst[i], &word, 8);
+    }
+    crc = (uint32_t)crc64;
+#endif
+    for (; i + 4 <= len; i += 4) {
+        uint32_t word;
+        memcpy(&word, &src[i], 4);
+        crc = _mm_crc32_u32(crc, word);
+        memcpy(&dst[i], &word, 4);
+    }
+    for (; i < len; i++) {
+        dst[i] = src[i];
+        crc = _mm_crc32_u8(crc, (unsigned char)src[i]);
+    }
+    return crc;
+}
+
+/* SSE2 kernels, 16 bytes at a time. Streaming stores need 16-byte aligned destinations. */
+
+void PageOpsZeroSSE2(char* dst, int len) {
+    __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        _mm_storeu_si128((__m128i*)&dst[i], zero);
+    }
+    PageOpsZeroScalar(&dst[i], len - i);
+}
+
+void PageOpsZeroStreamSSE2(char* dst, int len) {
+    int head = (16 - ((uintptr_t)dst & 15)) & 15;
+    if (head > len) head = len;
+    PageOpsZeroScalar(dst, head);
+    __m128i zero = _mm_setzero_si128();
+    int i = head;
+    for (; i + 16 <= len; i += 16) {
+        _mm_stream_si128((__m128i*)&dst[i], zero);
+    }
+    _mm_sfence();
+    PageOpsZeroScalar(&dst[i], len - i);
+}
+
+void PageOpsCopySSE2(char* dst, const char* src, int len) {
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        _mm_storeu_si128((__m128i*)&dst[i], _mm_loadu_si128((const __m128i*)&src[i]));
+    }
+    PageOpsCopyScalar(&dst[i], &src[i], len - i);
+}
+
+void PageOpsCopyStreamSSE2(char* dst, const char* src, int len) {
+    int head = (16 - ((uintptr_t)dst & 15)) & 15;
+    if (head > len) head = len;
+    PageOpsCopyScalar(dst, src, head);
+    int i = head;
+    for (; i + 16 <= len; i += 16) {
+        _mm_stream_si128((__m128i*)&dst[i], _mm_loadu_si128((const __m128i*)&src[i]));
+    }
+    _mm_sfence();
+    PageOpsCopyScalar(&dst[i], &src[i], len - i);
+}
+
+int PageOpsEqualSSE2(const char* a, const char* b, int len) {
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)&a[i]);
+        __m128i y = _mm_loadu_si128((const __m128i*)&b[i]);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF) {
+            return 0;
+        }
+    }
+    return PageOpsEqualScalar(&a[i], &b[i], len - i);
+}
+
+int PageOpsIsZeroSSE2(const char* src, int len) {
+    __m128i bits = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        bits = _mm_or_si128(bits, _mm_loadu_si128((const __m128i*)&src[i]));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(bits, _mm_setzero_si128())) != 0xFFFF) {
+        return 0;
+    }
+    return PageOpsIsZeroScalar(&src[i], len - i);
+}
+
+void PageOpsChecksumBlocksSSE2(const char* src, int blocks, uint32_t* a, uint32_t* b) {
+    __m128i a0 = _mm_loadu_si128((const __m128i*)&a[0]), a1 = _mm_loadu_si128((const __m128i*)&a[4]);
+    __m128i b0 = _mm_loadu_si128((const __m128i*)&b[0]), b1 = _mm_loadu_si128((const __m128i*)&b[4]);
+    for (int i = 0; i < blocks; i++, src += CHECKSUM_BLOCK) {
+        a0 = _mm_add_epi32(a0, _mm_loadu_si128((const __m128i*)&src[0]));
+        a1 = _mm_add_epi32(a1, _mm_loadu_si128((const __m128i*)&src[16]));
+        b0 = _mm_add_epi32(b0, a0);
+        b1 = _mm_add_epi32(b1, a1);
+    }
+    _mm_storeu_si128((__m128i*)&a[0], a0);
+    _mm_storeu_si128((__m128i*)&a[4], a1);
+    _mm_storeu_si128((__m128i*)&b[0], b0);
+    _mm_storeu_si128((__m128i*)&b[4], b1);
+}
+
+/* AVX2 kernels, 32 bytes at a time, with SSE2 handling what is left. */
+
+__attribute__((target("avx2")))
+void PageOpsZeroAVX2(char* dst, int len) {
+    __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        _mm256_storeu_si256((__m256i*)&dst[i], zero);
+    }
+    PageOpsZeroSSE2(&dst[i], len - i);
+}
+
+__attribute__((target("avx2")))
+void PageOpsZeroStreamAVX2(char* dst, int len) {
+    int head = (32 - ((uintptr_t)dst & 31)) & 31;
+    if (head > len) head = len;
+    PageOpsZeroSSE2(dst, head);
+    __m256i zero = _mm256_setzero_si256();
+    int i = head;
+    for (; i + 32 <= len; i += 32) {
+        _mm256_stream_si256((__m256i*)&dst[i], zero);
+    }
+    _mm_sfence();
+    PageOpsZeroSSE2(&dst[i], len - i);
+}
+
+__attribute__((target("avx2")))
+void PageOpsCopyAVX2(char* dst, const char* src, int len) {
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        _mm256_storeu_si256((__m256i*)&dst[i], _mm256_loadu_si256((const __m256i*)&src[i]));
+    }
+    PageOpsCopySSE2(&dst[i], &src[i], len - i);
+}
+
+__attribute__((target("avx2")))
+void PageOpsCopyStreamAVX2(char* dst, const char* src, int len) {
+    int head = (32 - ((uintptr_t)dst & 31)) & 31;
+    if (head > len) head = len;
+    PageOpsCopySSE2(dst, src, head);
+    int i = head;
+    for (; i + 32 <= len; i += 32) {
+        _mm256_stream_si256((__m256i*)&dst[i], _mm256_loadu_si256((const __m256i*)&src[i]));
+    }
+    _mm_sfence();
+    PageOpsCopySSE2(&dst[i], &src[i], len - i);
+}
+
+__attribute__((target("avx2")))
+int PageOpsEqualAVX2(const char* a, const char* b, int len) {
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)&a[i]);
+        __m256i y = _mm256_loadu_si256((const __m256i*)&b[i]);
+        if ((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) != 0xFFFFFFFFu) {
+            return 0;
+        }
+    }
+    return PageOpsEqualSSE2(&a[i], &b[i], len - i);
+}
+
+__attribute__((target("avx2")))
+int PageOpsIsZeroAVX2(const char* src, int len) {
+    __m256i bits = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        bits = _mm256_or_si256(bits, _mm256_loadu_si256((const __m256i*)&src[i]));
+    }
+    if (!_mm256_testz_si256(bits, bits)) {
+        return 0;
+    }
+    return PageOpsIsZeroSSE2(&src[i], len - i);
+}
+
+__attribute__((target("avx2")))
+void PageOpsChecksumBlocksAVX2(const char* src, int blocks, uint32_t* a, uint32_t* b) {
+    __m256i sumA = _mm256_loadu_si256((const __m256i*)a);
+    __m256i sumB = _mm256_loadu_si256((const __m256i*)b);
+    for (int i = 0; i < blocks; i++, src += CHECKSUM_BLOCK) {
+        sumA = _mm256_add_epi32(sumA, _mm256_loadu_si256((const __m256i*)src));
+        sumB = _mm256_add_epi32(sumB, sumA);
+    }
+    _mm256_storeu_si256((__m256i*)a, sumA);
+    _mm256_storeu_si256((__m256i*)b, sumB);
+}
+
+#endif // PAGEOPS_X86
+
+PageOpsKernels kernelSets[] = {
+    { "scalar", PageOpsZeroScalar, PageOpsZeroScalar, PageOpsCopyScalar, PageOpsCopyScalar,
+      PageOpsEqualScalar, PageOpsIsZeroScalar, PageOpsChecksumBlocksScalar },
+#ifdef PAGEOPS_X86
+    { "sse2", PageOpsZeroSSE2, PageOpsZeroStreamSSE2, PageOpsCopySSE2, PageOpsCopyStreamSSE2,
+      PageOpsEqualSSE2, PageOpsIsZeroSSE2, PageOpsChecksumBlocksSSE2 },
+    { "avx2", PageOpsZeroAVX2, PageOpsZeroStreamAVX2, PageOpsCopyAVX2, PageOpsCopyStreamAVX2,
+      PageOpsEqualAVX2, PageOpsIsZeroAVX2, PageOpsChecksumBlocksAVX2 },
+#endif
+};
+
+PageOpsKernels* kernels = &kernelSets[PAGEOPS_SCALAR];
+
+/* Tells whether the CPU can run a kernel set (-1 asks about the crc32 instruction). */
+int PageOpsSupported(int set) {
+#ifdef PAGEOPS_X86
+    __builtin_cpu_init();
+    if (set == PAGEOPS_SSE2) {
+        return __builtin_cpu_supports("sse2");
+    } else if (set == -1) {
+        return __builtin_cpu_supports("sse4.2");
+    } else if (set == PAGEOPS_AVX2) {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    return set == PAGEOPS_SCALAR;
+}
+
+/*
+ * Public Interface:
+ */
+
+/* Picks the widest kernel set the CPU supports. */
+void PageOps_Init() {
+    PageOpsInitCRC32C();
+    for (int set = PAGEOPS_AVX2; set >= PAGEOPS_SCALAR; set--) {
+        if (PageOps_Select(set)) {
+            return;
+        }
+    }
+}
+
+/* Uses a given kernel set, e.g. to compare them. Returns FALSE if the CPU cannot run it. */
+int PageOps_Select(int set) {
+    if (set < PAGEOPS_SCALAR || set > PAGEOPS_AVX2 || !PageOpsSupported(set)) {
+        return 0;
+    }
+    kernels = &kernelSets[set];
+    copyCRC32C = PageOpsCopyCRC32CScalar;
+#ifdef PAGEOPS_X86
+    if (set != PAGEOPS_SCALAR && PageOpsSupported(-1)) {
+        copyCRC32C = PageOpsCopyCRC32CHardware;
+    }
+#endif
+    return 1;
+}
+
+const char* PageOps_Name() {
+    return kernels->name;
+}
+
+void PageOps_Zero(char* dst, int len) {
+    kernels->zero(dst, len);
+}
+
+/* Zeroes with non-temporal stores, for memory that will not be read again soon. */
+void PageOps_ZeroStream(char* dst, int len) {
+    kernels->zeroStream(dst, len);
+}
+
+void PageOps_Copy(char* dst, const char* src, int len) {
+    kernels->copy(dst, src, len);
+}
+
+/* Copies with non-temporal stores, for a destination that will not be read again soon. */
+void PageOps_CopyStream(char* dst, const char* src, int len) {
+    kernels->copyStream(dst, src, len);
+}
+
+int PageOps_Equal(const char* a, const char* b, int len) {
+    return kernels->equal(a, b, len);
+}
+
+int PageOps_IsZero(const char* src, int len) {
+    return kernels->isZero(src, len);
+}
+
+/* 64-bit checksum of a buffer, for content hashing (not cryptographic). */
+uint64_t PageOps_Checksum(const char* src, int len) {
+    uint32_t a[CHECKSUM_LANES] = { 0 }, b[CHECKSUM_LANES] = { 0 };
+    int blocks = len / CHECKSUM_BLOCK;
+    kernels->checksumBlocks(src, blocks, a, b);
+    if (len % CHECKSUM_BLOCK != 0) {
+        char last[CHECKSUM_BLOCK] = { 0 };
+        memcpy(last, &src[blocks * CHECKSUM_BLOCK], len % CHECKSUM_BLOCK);
+        PageOpsChecksumBlocksScalar(last, 1, a, b);
+    }
+
+    uint64_t hash = (uint64_t)len;
+    for (int j = 0; j < CHECKSUM_LANES; j++) {
+        hash ^= ((uint64_t)b[j] << 32) | a[j];
+        hash *= 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+/* Copies a buffer and returns the CRC32C of the bytes copied, computed in the same pass. */
+uint32_t PageOps_CopyCRC32C(char* dst, const char* src, int len) {
+    return ~copyCRC32C(dst, src, len, ~0u);
+}
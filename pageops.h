@@ -0,0 +1,33 @@
+#ifndef PAGEOPS_H
+#define PAGEOPS_H
+
+#include <stdint.h>
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Bulk operations on page sized buffers. Each has scalar, SSE2 and AVX2 kernels; the widest
+ * one the CPU supports is picked at run time. Lengths need not be a multiple of the vector
+ * width and buffers need not be aligned. Every kernel set gives identical results.
+ */
+
+// Kernel sets, from narrowest to widest
+#define PAGEOPS_SCALAR 0
+#define PAGEOPS_SSE2 1
+#define PAGEOPS_AVX2 2
+
+void PageOps_Init();
+int PageOps_Select(int kernels);
+const char* PageOps_Name();
+void PageOps_Zero(char* dst, int len);
+void PageOps_ZeroStream(char* dst, int len);
+void PageOps_Copy(char* dst, const char* src, int len);
+void PageOps_CopyStream(char* dst, const char* src, int len);
+int PageOps_Equal(const char* a, const char* b, int len);
+int PageOps_IsZero(const char* src, int len);
+uint64_t PageOps_Checksum(const char* src, int len);
+uint32_t PageOps_CopyCRC32C(char* dst, const char* src, int len);
+
+#endif // PAGEOPS_H
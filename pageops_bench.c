@@ -0,0 +1,137 @@
+/*
+ * Microbenchmarks for the page operation kernels (make bench; ./pageops_bench [pagesize]).
+ * Checks every kernel set the CPU supports against the scalar one first, then reports the
+ * throughput of each operation over a buffer much larger than the caches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pageops.h"
+
+#define BENCH_BYTES (64 << 20)
+#define BENCH_ROUNDS 5
+
+double BenchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Compares a kernel set with the scalar kernels on odd lengths and alignments. */
+int BenchCheck(int set, char* a, char* b) {
+    char check[] = "123456789";
+    if (PageOps_CopyCRC32C(b, check, 9) != 0xE3069283u) {
+        printf("%s: wrong CRC32C of the check string\n", PageOps_Name());
+        return 0;
+    }
+    for (int trial = 0; trial < 2000; trial++) {
+        int len = rand() % 300, offset = rand() % 64;
+        for (int i = 0; i < len + 64; i++) {
+            a[i] = (trial % 3 == 0) ? 0 : rand();
+        }
+        memcpy(b, a, len + 64);
+        if (trial % 2 == 0 && len > 0) {
+            b[offset + rand() % len] ^= 1;
+        }
+
+        PageOps_Select(PAGEOPS_SCALAR);
+        int equal = PageOps_Equal(a + offset, b + offset, len);
+        int isZero = PageOps_IsZero(a + offset, len);
+        uint64_t checksum = PageOps_Checksum(a + offset, len);
+        uint32_t crc = PageOps_CopyCRC32C(b + 1024 + offset, a + offset, len);
+
+        PageOps_Select(set);
+        if (PageOps_Equal(a + offset, b + offset, len) != equal
+            || PageOps_IsZero(a + offset, len) != isZero
+            || PageOps_Checksum(a + offset, len) != checksum
+            || PageOps_CopyCRC32C(b + 1024 + offset, a + offset, len) != crc) {
+            printf("%s: mismatch at length %d offset %d\n", PageOps_Name(), len, offset);
+            return 0;
+        }
+        PageOps_CopyStream(b + offset, a + offset, len);
+        int copied = memcmp(b + offset, a + offset, len) == 0;
+        PageOps_ZeroStream(a + offset, len);
+        if (!copied || !PageOps_IsZero(a + offset, len)) {
+            printf("%s: copy/zero failed at length %d offset %d\n", PageOps_Name(), len, offset);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void BenchReport(const char* op, double seconds) {
+    printf("  %-12s %8.2f GB/s\n", op, (double)BENCH_BYTES * BENCH_ROUNDS / seconds / 1e9);
+}
+
+int main(int argc, char* argv[]) {
+    int pageSize = (argc > 1) ? atoi(argv[1]) : 4096;
+    if (pageSize < 1 || BENCH_BYTES % pageSize != 0) {
+        printf("Page size must divide %d.\n", BENCH_BYTES);
+        return 1;
+    }
+    int pages = BENCH_BYTES / pageSize;
+    char* src = aligned_alloc(64, BENCH_BYTES);
+    char* dst = aligned_alloc(64, BENCH_BYTES);
+    memset(src, 0, BENCH_BYTES);
+    memset(dst, 1, BENCH_BYTES);
+    volatile uint64_t sink = 0;
+    PageOps_Init();
+
+    for (int set = PAGEOPS_SCALAR; set <= PAGEOPS_AVX2; set++) {
+        if (!PageOps_Select(set)) {
+            continue;
+        }
+        if (!BenchCheck(set, src, dst)) {
+            return 1;
+        }
+        PageOps_Select(set);
+        memset(src, 0, BENCH_BYTES);
+        printf("%s, %d byte pages:\n", PageOps_Name(), pageSize);
+
+        double start = BenchNow();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+            for (int p = 0; p < pages; p++) PageOps_Zero(&dst[p * pageSize], pageSize);
+        BenchReport("zero", BenchNow() - start);
+
+        start = BenchNow();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+            for (int p = 0; p < pages; p++) PageOps_ZeroStream(&dst[p * pageSize], pageSize);
+        BenchReport("zero (nt)", BenchNow() - start);
+
+        start = BenchNow();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+            for (int p = 0; p < pages; p++) PageOps_Copy(&dst[p * pageSize], &src[p * pageSize], pageSize);
+        BenchReport("copy", BenchNow() - start);
+
+        start = BenchNow();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+            for (int p = 0; p < pages; p++) sink += PageOps_CopyCRC32C(&dst[p * pageSize], &src[p * pageSize], pageSize);
+        BenchReport("copy+crc32c", BenchNow() - start);
+
+        start = BenchNow();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+            for (int p = 0; p < pages; p++) PageOps_CopyStream(&dst[p * pageSize], &src[p * pageSize], pageSize);
+        BenchReport("copy (nt)", BenchNow() - start);
+
+        start = BenchNow();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+            for (int p = 0; p < pages; p++) sink += PageOps_Equal(&dst[p * pageSize], &src[p * pageSize], pageSize);
+        BenchReport("equal", BenchNow() - start);
+
+        start = BenchNow();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+            for (int p = 0; p < pages; p++) sink += PageOps_IsZero(&src[p * pageSize], pageSize);
+        BenchReport("is zero", BenchNow() - start);
+
+        start = BenchNow();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+            for (int p = 0; p < pages; p++) sink += PageOps_Checksum(&src[p * pageSize], pageSize);
+        BenchReport("checksum", BenchNow() - start);
+    }
+    free(src);
+    free(dst);
+    return 0;
+}
@@ -9,68 +9,310 @@
 #include "mmu.h"
 #include "pagetable.h"
 #include "memsim.h"
-
-int pageToEvict = 1;
-
+#include "policy.h"
+#include "process.h"
+#include "stats.h"
+#include "readahead.h"
+#include "pageops.h"
+#include "checkpoint.h"
+#include "eventlog.h"
+#include "numa.h"
+#include "tier.h"
+#include "cost.h"
+#include "arena.h"
+
+/*
+ * Data pages evicted while their owner's page table was itself swapped out. The owner's
+ * entry is rewritten once the evicted frame has been handed over, since the frame may
+ * be the one the owner's page table is about to be swapped into.
+ */
 typedef struct {
-    int ptStartPA;
-    int present;
-} ptRegister;
+    int pid;
+    int vpn;
+    int swapSlot;    // Or the fill byte of a same-filled page
+    int sameFilled;
+} pendingPTE;
+
+pendingPTE pendingPTEs[NUM_FRAMES];
+int numPendingPTEs = 0;
+
+// Updates whose owner's page table could not be brought back in, because every other
+// frame was pinned. The stale entries sit in the swapped out table, where nothing reads
+// them, and are rewritten as soon as the table is swapped back in.
+pendingPTE* parkedPTEs = NULL;
+int numParkedPTEs = 0;
+int parkedCapacity = 0;
+
+// Same-filled pages are swapped out without a slot, and new pages map the zero frame
+int dedupEnabled = FALSE;
+
+// Shared, read-only frame of zeros, claimed while any page maps it
+int zeroFrame = -1;
+
+/* Reverse map of a shared frame: one node per page mapping it. */
+typedef struct RmapEntry {
+    int pid;
+    int vpn;
+    struct RmapEntry* next;
+} RmapEntry;
+
+RmapEntry* rmap[NUM_FRAMES];
+Pool rmapPool;
+
+/* Physical address of the entry for a VPN. The page table must be resident. */
+int PTEntryPA(int pid, int VPN) {
+    return Proc_Get(pid)->ptStartPA + (VPN * PTE_SIZE);
+}
 
-ptRegister ptRegVals[NUM_PROCESSES];  // Stores page table root for each process
+/* Reads the frame (or swap slot) number stored in an entry. */
+int PTEFrameField(const char* entry) {
+    return (unsigned char)entry[1]
+         | ((unsigned char)entry[2] << 8)
+         | ((unsigned char)entry[3] << 16);
+}
 
-<<<<<<< HEAD
-// Function to set a page table entry
-void PT_SetPTE(int pid, int VPN, int PFN, int valid, int protection, int present, int referenced) {
+/* Marks a data page as swapped out, to a slot or as a fill byte, in its (resident) page table. */
+void PTSetSwapped(int pid, int VPN, int swapSlot, int sameFilled) {
     char* physmem = Memsim_GetPhysMem();
-    int pt_base = PT_GetRootPtrRegVal(pid);
-    int entry = pt_base + (VPN * 5);  // 5 bytes per entry now to store swap info
-=======
+    int entry = PTEntryPA(pid, VPN);
+    int protection = (physmem[entry] & PTE_WRITE) ? 1 : 0;
+    PT_SetPTE(pid, VPN, swapSlot, 1, protection, 0, 0);
+    if (sameFilled) {
+        physmem[entry] |= PTE_SAMEFILLED;
+    }
+}
+
+/* Brings a swapped out page into a claimed frame, from its swap slot or its fill byte. */
+void PTSwapInPage(int pfn, int swapSlot, int sameFilled) {
+    if (sameFilled) {
+        memset(&Memsim_GetPhysMem()[PAGE_START(pfn)], swapSlot, PAGE_SIZE);
+        Memsim_MarkDirty(pfn);
+        Cost_Charge(COST_MINOR_FAULT);
+    } else {
+        Memsim_SwapIn(pfn, swapSlot * PAGE_SIZE);
+    }
+}
+
+void PTPark(pendingPTE update) {
+    if (numParkedPTEs == parkedCapacity) { // the outgrown array stays in the arena
+        parkedCapacity = parkedCapacity ? parkedCapacity * 2 : NUM_FRAMES;
+        pendingPTE* grown = Arena_Alloc(parkedCapacity * sizeof(pendingPTE));
+        if (numParkedPTEs > 0) {
+            memcpy(grown, parkedPTEs, numParkedPTEs * sizeof(pendingPTE));
+        }
+        parkedPTEs = grown;
+    }
+    parkedPTEs[numParkedPTEs++] = update;
+}
+
+/* Rewrites the parked entries of a process whose page table just came back in. */
+void PTApplyParked(int pid) {
+    int kept = 0;
+    for (int i = 0; i < numParkedPTEs; i++) {
+        pendingPTE update = parkedPTEs[i];
+        if (update.pid == pid) {
+            PTSetSwapped(update.pid, update.vpn, update.swapSlot, update.sameFilled);
+        } else {
+            parkedPTEs[kept++] = update;
+        }
+    }
+    numParkedPTEs = kept;
+}
+
+/*
+ * Applies entry updates deferred by PT_Evict. Bringing the owner's page table back
+ * in may evict further pages, which queue their own updates. A page table brought in
+ * only for its update is not needed by the instruction, so it is left unpinned. If it
+ * cannot be brought in at all, the update is parked until it is.
+ */
+void PTFinishEvictions() {
+    while (numPendingPTEs > 0) {
+        pendingPTE update = pendingPTEs[--numPendingPTEs];
+        Process* owner = Proc_Get(update.pid);
+        int wasPinned = owner->ptPresent && Memsim_IsPinned(PFN(owner->ptStartPA));
+        if (PT_GetRootPtrRegVal(update.pid) == -1) {
+            PTPark(update);
+            continue;
+        }
+        PTSetSwapped(update.pid, update.vpn, update.swapSlot, update.sameFilled);
+        if (!wasPinned) {
+            Memsim_Unpin(PFN(owner->ptStartPA));
+        }
+    }
+}
+
+int PTEvictFrame(int pfn);
+
+/* Policy filter: frames of the given process. */
+int PTFrameOwnedBy(int pfn, int pid) {
+    return Memsim_GetFrameInfo(pfn)->pid == pid;
+}
+
+/* Policy filter: frames of processes resident above their soft limit. */
+int PTFrameOverSoftLimit(int pfn, int unused) {
+    Process* owner = Proc_Get(Memsim_GetFrameInfo(pfn)->pid);
+    return owner->softLimit > 0 && owner->stats.rss > owner->softLimit;
+}
+
+/*
+ * Claims a frame for a page of a process in the current instruction. A process at its hard
+ * limit only reclaims from its own pages. Otherwise a free frame is used, or a page is
+ * evicted if memory is full. The frame is pinned until the instruction completes.
+ * Returns -1 if nothing can be evicted.
+ */
+int PTClaimFrame(int pid) {
+    Process* proc = Proc_Get(pid);
+    int pfn;
+    if (proc->hardLimit > 0 && proc->stats.rss >= proc->hardLimit) {
+        pfn = PT_EvictFrom(PTFrameOwnedBy, pid);
+        if (pfn != -1) {
+            proc->stats.limitReclaims++;
+            Stats_DirectReclaim();
+        }
+    } else {
+        pfn = Numa_AllocFrame(pid);
+        if (pfn == -1 && (pfn = PT_Evict()) != -1) {
+            Stats_DirectReclaim();
+        }
+    }
+    if (pfn == -1) {
+        return -1;
+    }
+    Memsim_Pin(pfn);
+    return pfn;
+}
+
+/* Records which page now occupies a frame and counts it as used. */
+void PTSetFrameOwner(int pfn, int pid, int VPN) {
+    FrameInfo* info = Memsim_GetFrameInfo(pfn);
+    info->pid = pid;
+    info->vpn = VPN;
+    info->remoteAccesses = 0;
+    Memsim_Pin(pfn);
+    Policy_FrameAccessed(pfn);
+    Stats_FrameClaimed(pid);
+}
+
+void PTRmapAdd(int pfn, int pid, int VPN) {
+    RmapEntry* node = Pool_Alloc(&rmapPool);
+    node->pid = pid;
+    node->vpn = VPN;
+    node->next = rmap[pfn];
+    rmap[pfn] = node;
+    Memsim_GetFrameInfo(pfn)->mapCount++;
+    Memsim_SetShared(pfn, TRUE);
+}
+
+void PTRmapRemove(int pfn, int pid, int VPN) {
+    for (RmapEntry** link = &rmap[pfn]; *link != NULL; link = &(*link)->next) {
+        if ((*link)->pid == pid && (*link)->vpn == VPN) {
+            RmapEntry* node = *link;
+            *link = node->next;
+            Pool_Free(&rmapPool, node);
+            Memsim_SetShared(pfn, --Memsim_GetFrameInfo(pfn)->mapCount > 0);
+            return;
+        }
+    }
+}
+
+/* Turns the private frame of a data page into a shared frame mapped by that page alone. */
+void PTShareFrame(int pfn) {
+    FrameInfo* info = Memsim_GetFrameInfo(pfn);
+    PTRmapAdd(pfn, info->pid, info->vpn);
+    Stats_FrameReleased(info->pid);
+    info->pid = -1;
+    info->vpn = FRAME_VPN_SHARED;
+    info->prefetched = 0;
+}
+
+/*
+ * Maps one more page to the zero frame, claiming it first if no page maps it yet.
+ * Returns -1 if no frame can be found for it.
+ */
+int PTGetZeroFrame(int pid, int VPN) {
+    if (zeroFrame == -1) {
+        int pfn = PTClaimFrame(pid);
+        if (pfn == -1) {
+            return -1;
+        }
+        FrameInfo* info = Memsim_GetFrameInfo(pfn);
+        info->pid = -1;
+        info->vpn = FRAME_VPN_SHARED;
+        zeroFrame = pfn;
+    }
+    PTRmapAdd(zeroFrame, pid, VPN);
+    return zeroFrame;
+}
+
+/* Drops the mapping of a page to a shared frame, freeing the frame once no page maps it. */
+void PTPutSharedFrame(int pfn, int pid, int VPN) {
+    PTRmapRemove(pfn, pid, VPN);
+    if (Memsim_GetFrameInfo(pfn)->mapCount > 0) {
+        return;
+    }
+    if (pfn == zeroFrame) {
+        zeroFrame = -1;
+    }
+    Memsim_FreePFN(pfn);
+}
+
+/*
+ * Public Interface:
+ */
+
 void PT_SetPTE(int pid, int VPN, int PFN, int valid, int protection, int present, int referenced) {
     char* physmem = Memsim_GetPhysMem();
-    int pt_base = PT_GetRootPtrRegVal(pid);
-    int entry = pt_base + (VPN * 4);
->>>>>>> 6e52b80ec79db43d862435d37c7e1c431f5261ca
-
-    physmem[entry] = PFN;
-    physmem[entry + 1] = valid;
-    physmem[entry + 2] = protection;
-    physmem[entry + 3] = present;
-<<<<<<< HEAD
-    physmem[entry + 4] = referenced;  // Use this for swap_offset if needed
+    int entry = PTEntryPA(pid, VPN);
+
+    physmem[entry] = (valid ? PTE_VALID : 0) | (protection ? PTE_WRITE : 0)
+                   | (present ? PTE_PRESENT : 0) | (referenced ? PTE_REFERENCED : 0);
+    physmem[entry + 1] = PFN & 0xFF;
+    physmem[entry + 2] = (PFN >> 8) & 0xFF;
+    physmem[entry + 3] = (PFN >> 16) & 0xFF;
+    Memsim_MarkDirty(PAGE_NUM(entry));
 }
 
+/*
+ * Decodes the entry for a VPN, bringing the page table in if needed.
+ * Returns NULL if the page is not mapped. The returned entry is overwritten by the next call.
+ */
 PageTableEntry* PT_GetPTE(int pid, int vpn) {
     char* physmem = Memsim_GetPhysMem();
-    int pt_base = PT_GetRootPtrRegVal(pid);
-    int entry = pt_base + (vpn * 5);
+    if (PT_GetRootPtrRegVal(pid) == -1) return NULL;
+    int entry = PTEntryPA(pid, vpn);
 
     static PageTableEntry pte;
-    pte.PFN = physmem[entry];
-    pte.valid = physmem[entry + 1];
-    pte.protection = physmem[entry + 2];
-    pte.present = physmem[entry + 3];
-    pte.referenced = physmem[entry + 4];
-    pte.rw_bit = pte.protection;  // Assuming rw_bit is the same as protection flag
+    unsigned char flags = physmem[entry];
+    pte.PFN = PTEFrameField(&physmem[entry]);
+    pte.valid = (flags & PTE_VALID) ? 1 : 0;
+    pte.protection = (flags & PTE_WRITE) ? 1 : 0;
+    pte.present = (flags & PTE_PRESENT) ? 1 : 0;
+    pte.referenced = (flags & PTE_REFERENCED) ? 1 : 0;
+    pte.rw_bit = pte.protection;
+    pte.sameFilled = (flags & PTE_SAMEFILLED) ? 1 : 0;
+    pte.dirty = (flags & PTE_DIRTY) ? 1 : 0;
 
     if (!pte.valid) return NULL; // If entry is invalid, return NULL
 
     return &pte;
 }
 
-// Initialize a page table for a process
+/*
+ * Set all PTE valid bits to zero (invalid) and point the process's register at the table.
+ */
 int PT_PageTableInit(int pid, int pa) {
     char* physmem = Memsim_GetPhysMem();
 
-    for (int i = 0; i < NUM_PAGES * 5; i += 5) {
-        physmem[pa + i] = -1;  // Mark all VPNs as invalid
-    }
+    Process* proc = Proc_Get(pid);
+
+    PageOps_Zero(&physmem[pa], PAGE_SIZE);
+    Memsim_MarkDirty(PFN(pa));
+
+    proc->ptStartPA = pa;
+    proc->ptPresent = 1;
 
-    ptRegVals[pid].ptStartPA = pa;
-    ptRegVals[pid].present = 1;
+    printf("Put page table for PID %d into physical frame %d.\n", pid, PFN(pa));
 
-    printf("Put page table for PID %d into physical frame %d\n", pid, pa);
-    
     return pa;
 }
 
@@ -79,138 +321,300 @@ void PT_PageTableCreate(int pid, int pa) {
     if (!PT_PageTableExists(pid)) {
         PT_PageTableInit(pid, pa);
     }
-	
 }
 
-// Check if page table exists
+// Check if page table exists, whether resident or swapped out
 int PT_PageTableExists(int pid) {
-    return ptRegVals[pid].present;
+    Process* proc = Proc_Lookup(pid);
+    return proc != NULL && (proc->ptPresent || proc->ptStartPA != -1);
 }
 
-// Get root pointer register value (i.e., page table location)
+/*
+ * Gets the location of the start of the page table. Creates it on first use, and if it
+ * has been swapped out, brings it back into memory (evicting another page if needed).
+ * Returns -1 if no frame can be found for it.
+ */
 int PT_GetRootPtrRegVal(int pid) {
+    Process* proc = Proc_Get(pid);
+    if (proc->ptPresent) {
+        int pfn = PFN(proc->ptStartPA);
+        Memsim_Pin(pfn);
+        Policy_FrameAccessed(pfn);
+        return proc->ptStartPA;
+    }
+
+    int pfn = PTClaimFrame(pid);
+    if (pfn == -1) {
+        return -1;
+    }
     if (!PT_PageTableExists(pid)) {
-        int pa = Memsim_FirstFreePFN();
-        PT_PageTableCreate(pid, pa);
+        PT_PageTableCreate(pid, PAGE_START(pfn));
+        Cost_Charge(COST_ZERO_FILL);
+    } else {
+        int swapOffset = proc->ptStartPA;
+        EventLog_Record(EVENT_FAULT, pid, FRAME_VPN_PAGETABLE, -1, swapOffset, 0);
+        Memsim_SwapIn(pfn, swapOffset);
+        proc->ptStartPA = PAGE_START(pfn);
+        proc->ptPresent = 1;
+        PTApplyParked(pid);
+        printf("Swapped disk offset %d into Frame %d.\n", swapOffset, pfn);
+        Stats_PageSwappedIn(pid, TRUE);
+        EventLog_Record(EVENT_SWAP_IN, pid, FRAME_VPN_PAGETABLE, pfn, swapOffset, 0);
     }
-    return ptRegVals[pid].ptStartPA;
+    PTSetFrameOwner(pfn, pid, FRAME_VPN_PAGETABLE);
+    PTFinishEvictions();
+    return proc->ptStartPA;
 }
 
-// Evict a page from memory to swap file
-int PT_Evict() {
-    char* physmem = Memsim_GetPhysMem();
-    FILE* swapFile = MMU_GetSwapFileHandle();
-    
-    int evictPage = pageToEvict * PAGE_SIZE;
-    pageToEvict = (pageToEvict + 1) % NUM_PAGES;  // Round-Robin eviction
+/*
+ * Evicts the page in a frame, which may be a page table. Writes it to the swap file and
+ * updates the page table entry, or page table register, that pointed at it. With dedup
+ * on, a data page filled with a single byte value keeps just that value in its entry.
+ * Returns the frame, still claimed for the caller, or -1 if it could not be evicted.
+ */
+int PTEvictFrame(int pfn) {
+    if (pfn == -1) {
+        return -1;
+    }
+    FrameInfo victim = *Memsim_GetFrameInfo(pfn);
 
-    // Write the page to swap space
-    fseek(swapFile, evictPage, SEEK_SET);
-    fwrite(&physmem[evictPage], PAGE_SIZE, 1, swapFile);
-    
-    // Mark page as swapped and clear memory
-    memset(&physmem[evictPage], 0, PAGE_SIZE);
+    int fill = -1;
+    if (dedupEnabled && victim.vpn != FRAME_VPN_PAGETABLE) {
+        fill = Memsim_PageFillValue(pfn);
+    }
+    int swapOffset;
+    if (fill != -1) {
+        PageOps_ZeroStream(&Memsim_GetPhysMem()[PAGE_START(pfn)], PAGE_SIZE);
+        Memsim_MarkDirty(pfn);
+        swapOffset = fill * PAGE_SIZE;
+        printf("Swapped Frame %d out as a page filled with %d.\n", pfn, fill);
+        Stats_SameFilledPage();
+    } else {
+        swapOffset = Memsim_SwapOut(pfn);
+        if (swapOffset == -1) {
+            printf("Error: Swap space is full.\n");
+            return -1;
+        }
+        if (Tier_Lookup(swapOffset / PAGE_SIZE) != -1) {
+            printf("Demoted Frame %d to far memory at offset %d.\n", pfn, swapOffset);
+        } else {
+            printf("Swapped Frame %d to disk at offset %d.\n", pfn, swapOffset);
+        }
+    }
+    if (victim.prefetched) {
+        Readahead_Wasted(victim.pid);
+    }
+    Stats_FrameReleased(victim.pid);
+    Stats_PageSwappedOut(victim.pid, fill == -1);
+    EventLog_Record(EVENT_EVICT, victim.pid, victim.vpn, pfn, swapOffset,
+                    fill != -1 ? EVENT_FLAG_SAMEFILLED : 0);
+
+    Process* owner = Proc_Get(victim.pid);
+    if (victim.vpn == FRAME_VPN_PAGETABLE) {
+        owner->ptStartPA = swapOffset;
+        owner->ptPresent = 0;
+        MMU_TLBFlushPID(victim.pid);
+    } else if (owner->ptPresent) {
+        MMU_TLBInvalidate(victim.pid, victim.vpn);
+        PTSetSwapped(victim.pid, victim.vpn, swapOffset / PAGE_SIZE, fill != -1);
+    } else {
+        MMU_TLBInvalidate(victim.pid, victim.vpn);
+        assert(numPendingPTEs < NUM_FRAMES);
+        pendingPTEs[numPendingPTEs].pid = victim.pid;
+        pendingPTEs[numPendingPTEs].vpn = victim.vpn;
+        pendingPTEs[numPendingPTEs].swapSlot = swapOffset / PAGE_SIZE;
+        pendingPTEs[numPendingPTEs].sameFilled = (fill != -1);
+        numPendingPTEs++;
+    }
 
-    return evictPage;  // Return swap offset
+    // The frame stays claimed, now empty, for the caller
+    Memsim_ResetFrame(pfn);
+    return pfn;
 }
 
-int PT_VPNtoPA(int pid, int VPN) {
-    char* physmem = Memsim_GetPhysMem();
-    int pt_base = PT_GetRootPtrRegVal(pid);
-    int entry = pt_base + (VPN * 5);
-
-    if (physmem[entry + 1] == 1) { // Page is in memory
-        return (physmem[entry] * PAGE_SIZE);  
+/*
+ * Evicts the page chosen by the replacement policy. Processes above their soft limit give
+ * up pages first. Returns the freed frame number, still claimed for the caller,
+ * or -1 if no frame can be evicted.
+ */
+int PT_Evict() {
+    int pfn = -1;
+    if (Proc_LimitsConfigured()) {
+        pfn = Policy_SelectVictim(PTFrameOverSoftLimit, 0);
     }
-
-    int swap_offset = physmem[entry + 4];
-    if (swap_offset >= 0) {
-        int newFrame = Memsim_SwapIn(pid, VPN, swap_offset);
-        if (newFrame == -1) return -1;
-        return newFrame * PAGE_SIZE;
+    if (pfn == -1) {
+        pfn = Policy_SelectVictim(NULL, 0);
     }
-
-    return -1;  // Page not found
+    return PTEvictFrame(pfn);
 }
 
-
-
-// Check if process has write permissions to a page
-int PT_PIDHasWritePerm(int pid, int VPN) {
-    char* physmem = Memsim_GetPhysMem();
-    int pt_base = PT_GetRootPtrRegVal(pid);
-    int entry = pt_base + (VPN * 5);
-=======
+/* Evicts the page the replacement policy picks among the frames accepted by the filter. */
+int PT_EvictFrom(PolicyFilter filter, int arg) {
+    return PTEvictFrame(Policy_SelectVictim(filter, arg));
 }
-int PT_PageTableInit(int pid, int pa) {
+
+/*
+ * Resolves a load or store to a page with one walk of its page table. The entry is
+ * checked for a mapping, and for write permission on a store, before anything is swapped
+ * in. A store to a shared frame gets its private copy here too. The referenced bit (and
+ * the dirty bit on a store) is set in the same pass, and the frame is pinned.
+ * With inPlace set, a page in far memory is used where it is (frame NUM_FRAMES and up)
+ * until it is hot enough to promote, and the access is counted for the modeled latency.
+ * Returns the frame number, or an MMU_FAULT_* code.
+ */
+int PTTranslate(int pid, int VPN, int access, int inPlace) {
+    if (PT_GetRootPtrRegVal(pid) == -1) {
+        return MMU_FAULT_NOT_PRESENT;
+    }
     char* physmem = Memsim_GetPhysMem();
+    int entry = PTEntryPA(pid, VPN);
+    unsigned char flags = physmem[entry];
+    if (!(flags & PTE_VALID)) {
+        return MMU_FAULT_NOT_MAPPED;
+    }
+    if (access == MMU_ACCESS_WRITE && !(flags & PTE_WRITE)) {
+        return MMU_FAULT_PROTECTION;
+    }
 
-    for (int i = 0; i < NUM_PAGES * 4; i += 4) {
-        physmem[pa + i] = -1;
+    int pfn = PTEFrameField(&physmem[entry]);
+    int protection = (flags & PTE_WRITE) ? 1 : 0;
+    if (!(flags & PTE_PRESENT)) {
+        int swapSlot = pfn;
+        int sameFilled = (flags & PTE_SAMEFILLED) ? 1 : 0;
+        int far = sameFilled ? -1 : Tier_Lookup(swapSlot);
+        if (inPlace) {
+            Tier_CountAccess(far != -1 ? TIER_ACCESS_FAR : TIER_ACCESS_SWAP);
+            if (far != -1 && !Tier_Access(far)) {
+                return NUM_FRAMES + far;
+            }
+        }
+        int eventFlags = sameFilled ? EVENT_FLAG_SAMEFILLED : 0;
+        EventLog_Record(EVENT_FAULT, pid, VPN, -1, swapSlot * PAGE_SIZE, eventFlags);
+        pfn = PTClaimFrame(pid);
+        if (pfn == -1) {
+            return MMU_FAULT_NOT_PRESENT;
+        }
+        PTSwapInPage(pfn, swapSlot, sameFilled);
+        Stats_PageSwappedIn(pid, !sameFilled);
+        EventLog_Record(EVENT_SWAP_IN, pid, VPN, pfn, swapSlot * PAGE_SIZE, eventFlags);
+        PTSetFrameOwner(pfn, pid, VPN);
+        PTFinishEvictions();
+        // The page table is pinned, so it is still resident. Map the page before reading ahead.
+        PT_SetPTE(pid, VPN, pfn, 1, protection, 1, 1);
+        if (far != -1) {
+            printf("Promoted page %d of PID %d from far memory into Frame %d.\n", VPN, pid, pfn);
+        }
+        Readahead_Fault(pid, VPN);
+    } else {
+        if (inPlace) {
+            Tier_CountAccess(TIER_ACCESS_DRAM);
+        }
+        if (Memsim_GetFrameInfo(pfn)->prefetched) {
+            Memsim_GetFrameInfo(pfn)->prefetched = 0;
+            Readahead_Hit(pid);
+        }
     }
 
-    ptRegVals[pid].ptStartPA = pa;
-    ptRegVals[pid].present = 1;
+    if (access == MMU_ACCESS_WRITE && Memsim_GetFrameInfo(pfn)->mapCount > 0) {
+        int pa = PT_BreakCOW(pid, VPN, PAGE_START(pfn));
+        if (pa == -1) {
+            return MMU_FAULT_NOT_PRESENT;
+        }
+        pfn = PFN(pa);
+    }
 
-    // Move the print statement here so it gets printed even if PT_PageTableInit is called elsewhere
-    printf("Put page table for PID %d into physical frame %d\n", pid, pa);
-    
-    return pa;
+    physmem[entry] |= PTE_PRESENT | PTE_REFERENCED | (access == MMU_ACCESS_WRITE ? PTE_DIRTY : 0);
+    Memsim_MarkDirty(PFN(entry));
+    Memsim_Pin(pfn);
+    Policy_FrameAccessed(pfn);
+    return pfn;
 }
 
-
-void PT_PageTableCreate(int pid, int pa) {
-    if (!PT_PageTableExists(pid)) {
-        PT_PageTableInit(pid, pa);
-    }
+/*
+ * Searches through the process's page table. If an entry is found containing the specified VPN,
+ * return the address of the start of the corresponding physical page frame in physical memory.
+ *
+ * If the physical page is not present, first swaps in the phyical page from the physical disk
+ * (or far memory), and returns the physical address.
+ *
+ * Otherwise, returns -1.
+ */
+int PT_VPNtoPA(int pid, int VPN) {
+    int pfn = PTTranslate(pid, VPN, MMU_ACCESS_READ, FALSE);
+    return pfn < 0 ? -1 : PAGE_START(pfn);
 }
 
-int PT_PageTableExists(int pid) {
-    return ptRegVals[pid].present;
+/* Translates a load or store by a process. See PTTranslate. */
+int PT_TranslateForAccess(int pid, int VPN, int access) {
+    return PTTranslate(pid, VPN, access, TRUE);
 }
 
-int PT_GetRootPtrRegVal(int pid) {
-    if (!PT_PageTableExists(pid)) {
-        int pa = Memsim_FirstFreePFN();
-        PT_PageTableCreate(pid, pa);
+/*
+ * Swaps in a page of a process ahead of use, if it is mapped and swapped out. The page is
+ * not marked referenced and its frame is not pinned, so it is the first to go if unused.
+ * Returns TRUE if the page was brought in.
+ */
+int PT_Prefetch(int pid, int VPN) {
+    PageTableEntry* pte = PT_GetPTE(pid, VPN);
+    if (pte == NULL || pte->present) {
+        return FALSE;
     }
-    return ptRegVals[pid].ptStartPA;
-}
+    int swapSlot = pte->PFN;
+    int protection = pte->protection;
+    int sameFilled = pte->sameFilled;
 
-int PT_Evict() {
-    char* physmem = Memsim_GetPhysMem();
-    FILE* swapFile = MMU_GetSwapFileHandle();
-    int evictPage = pageToEvict * PAGE_SIZE;
-    pageToEvict = (pageToEvict + 1) % NUM_PAGES;
-    fwrite(&physmem[evictPage], PAGE_SIZE, 1, swapFile);
-    memset(&physmem[evictPage], 0, PAGE_SIZE);
-    return evictPage;
+    int pfn = PTClaimFrame(pid);
+    if (pfn == -1) {
+        return FALSE;
+    }
+    PTSwapInPage(pfn, swapSlot, sameFilled);
+    Stats_PagePrefetched(pid, !sameFilled);
+    EventLog_Record(EVENT_PREFETCH, pid, VPN, pfn, swapSlot * PAGE_SIZE,
+                    sameFilled ? EVENT_FLAG_SAMEFILLED : 0);
+    PTSetFrameOwner(pfn, pid, VPN);
+    PTFinishEvictions();
+    PT_SetPTE(pid, VPN, pfn, 1, protection, 1, 0);
+
+    FrameInfo* info = Memsim_GetFrameInfo(pfn);
+    info->prefetched = 1;
+    Memsim_Unpin(pfn);
+    Policy_FrameUnused(pfn);
+    return TRUE;
 }
 
-int PT_VPNtoPA(int pid, int VPN) {
-    char* physmem = Memsim_GetPhysMem();
-    int pt_base = PT_GetRootPtrRegVal(pid);
-    int entry = pt_base + (VPN * 4);
-
-    if (physmem[entry + 1] == 1) {
-        return physmem[entry] * PAGE_SIZE;
+/*
+ * Claims a frame for a new virtual page and maps it. Protection 1 allows writes.
+ * With dedup on, the page maps the shared zero frame until its first store.
+ * Returns the frame number, or -1 if no frame could be found.
+ */
+int PT_Map(int pid, int VPN, int protection) {
+    if (PT_GetRootPtrRegVal(pid) == -1) {
+        return -1;
+    }
+    int pfn = dedupEnabled ? PTGetZeroFrame(pid, VPN) : PTClaimFrame(pid);
+    if (pfn == -1) {
+        return -1;
     }
-    return -1;
+    if (dedupEnabled) {
+        Stats_ZeroPageMapped();
+    } else {
+        PTSetFrameOwner(pfn, pid, VPN);
+        Cost_Charge(COST_ZERO_FILL);
+    }
+    PTFinishEvictions();
+    PT_SetPTE(pid, VPN, pfn, 1, protection, 1, 1);
+    return pfn;
 }
 
+// Check if process has write permissions to a page
 int PT_PIDHasWritePerm(int pid, int VPN) {
-    char* physmem = Memsim_GetPhysMem();
-    int pt_base = PT_GetRootPtrRegVal(pid);
-    int entry = pt_base + (VPN * 4);
->>>>>>> 6e52b80ec79db43d862435d37c7e1c431f5261ca
-
-    if (physmem[entry + 1] == 1 && physmem[entry + 2] == 1) {
+    PageTableEntry* pte = PT_GetPTE(pid, VPN);
+    if (pte != NULL && pte->protection == 1) {
         return TRUE;
     }
     return FALSE;
 }
 
-<<<<<<< HEAD
 int PT_GetWritePerm(int pid, int vpn) {
     PageTableEntry* pte = PT_GetPTE(pid, vpn);
     if (pte == NULL) return 0; // If no mapping exists, assume no write permission
@@ -219,20 +623,290 @@ int PT_GetWritePerm(int pid, int vpn) {
 
 void PT_UpdateWritePerm(int pid, int vpn, int new_perm) {
     char* physmem = Memsim_GetPhysMem();
-    int pt_base = PT_GetRootPtrRegVal(pid);
-    int entry = pt_base + (vpn * 5); // Offset for 5-byte page table entry
+    if (PT_GetRootPtrRegVal(pid) == -1) return;
+    int entry = PTEntryPA(pid, vpn);
 
-    physmem[entry + 2] = new_perm; // Update write permission
+    if (new_perm) {
+        physmem[entry] |= PTE_WRITE;
+    } else {
+        physmem[entry] &= ~PTE_WRITE;
+    }
+    Memsim_MarkDirty(PFN(entry));
+    MMU_TLBInvalidate(pid, vpn); // a cached translation may allow stores
 }
 
+/*
+ * Clears the referenced bit of a present page and reports whether it was set. Only looks
+ * at resident page tables, it never faults one in. The TLB entry is dropped so the next
+ * access walks the table and sets the bit again.
+ */
+int PT_TestAndClearReferenced(int pid, int VPN) {
+    Process* proc = Proc_Lookup(pid);
+    if (proc == NULL || !proc->ptPresent) {
+        return FALSE;
+    }
+    char* physmem = Memsim_GetPhysMem();
+    int entry = PTEntryPA(pid, VPN);
+    if ((physmem[entry] & (PTE_PRESENT | PTE_REFERENCED)) != (PTE_PRESENT | PTE_REFERENCED)) {
+        return FALSE;
+    }
+    physmem[entry] &= ~PTE_REFERENCED;
+    Memsim_MarkDirty(PFN(entry));
+    MMU_TLBInvalidate(pid, VPN);
+    return TRUE;
+}
 
+/*
+ * Releases everything a process holds: its resident frames (data pages and page table),
+ * the swap slots of its swapped out pages, and the swap slot of its page table if that
+ * is swapped out too. Then removes the process. Returns FALSE if the process does not exist.
+ */
+int PT_DestroyProcess(int pid, int* framesFreed, int* slotsFreed) {
+    Process* proc = Proc_Lookup(pid);
+    *framesFreed = 0;
+    *slotsFreed = 0;
+    if (proc == NULL) {
+        return FALSE;
+    }
+
+    if (proc->ptStartPA != -1) {
+        char table[PAGE_SIZE];
+        if (proc->ptPresent) {
+            PageOps_Copy(table, &Memsim_GetPhysMem()[proc->ptStartPA], PAGE_SIZE);
+        } else {
+            // Read the swapped out table straight from disk, no need to fault it in.
+            // Parked updates are applied to the copy, so their pages' slots get freed.
+            Memsim_ReadSwap(proc->ptStartPA, table);
+            Memsim_FreeSwap(proc->ptStartPA);
+            (*slotsFreed)++;
+            int kept = 0;
+            for (int i = 0; i < numParkedPTEs; i++) {
+                pendingPTE update = parkedPTEs[i];
+                if (update.pid != pid) {
+                    parkedPTEs[kept++] = update;
+                    continue;
+                }
+                char* entry = &table[update.vpn * PTE_SIZE];
+                entry[0] = (entry[0] & (PTE_VALID | PTE_WRITE)) | (update.sameFilled ? PTE_SAMEFILLED : 0);
+                entry[1] = update.swapSlot & 0xFF;
+                entry[2] = (update.swapSlot >> 8) & 0xFF;
+                entry[3] = (update.swapSlot >> 16) & 0xFF;
+            }
+            numParkedPTEs = kept;
+        }
+        for (int vpn = 0; vpn < VPN(VIRTUAL_SIZE); vpn++) {
+            unsigned char flags = table[vpn * PTE_SIZE];
+            int field = PTEFrameField(&table[vpn * PTE_SIZE]);
+            if (!(flags & PTE_VALID)) {
+                continue;
+            }
+            if (!(flags & PTE_PRESENT) && !(flags & PTE_SAMEFILLED)) {
+                Memsim_FreeSwap(field * PAGE_SIZE);
+                (*slotsFreed)++;
+            } else if ((flags & PTE_PRESENT) && Memsim_GetFrameInfo(field)->mapCount > 0) {
+                PTPutSharedFrame(field, pid, vpn);
+            }
+        }
+    }
+
+    for (int pfn = 0; pfn < NUM_FRAMES; pfn++) {
+        if (Memsim_FrameInUse(pfn) && Memsim_GetFrameInfo(pfn)->pid == pid) {
+            Memsim_FreePFN(pfn);
+            (*framesFreed)++;
+        }
+    }
+
+    Proc_Destroy(pid);
+    return TRUE;
+}
 
 // Initialize all process page tables
-=======
->>>>>>> 6e52b80ec79db43d862435d37c7e1c431f5261ca
 void PT_Init() {
-    for (int i = 0; i < NUM_PROCESSES; i++) {
-        ptRegVals[i].ptStartPA = -1;
-        ptRegVals[i].present = 0;
+    Proc_Init();
+    Pool_Init(&rmapPool, sizeof(RmapEntry));
+    memset(rmap, 0, sizeof(rmap));
+    numPendingPTEs = 0;
+    numParkedPTEs = 0;
+    zeroFrame = -1;
+}
+
+/* Turns same-filled page detection on eviction and zero frame mapping on or off. */
+void PT_SetDedup(int enabled) {
+    dedupEnabled = enabled;
+}
+
+/*
+ * Gives a page mapping a shared frame its own copy before it is written (copy-on-write).
+ * pa is the translated address of the store. Returns it unchanged for a private page, the
+ * address in the new copy otherwise, or -1 if no frame could be found for the copy.
+ */
+int PT_BreakCOW(int pid, int VPN, int pa) {
+    int shared = PFN(pa);
+    if (Memsim_GetFrameInfo(shared)->mapCount == 0) {
+        return pa;
+    }
+    // The translation may have come from the TLB, bring the page table in and pin it first
+    if (PT_GetRootPtrRegVal(pid) == -1) {
+        return -1;
+    }
+    Stats_COWBreak();
+    Cost_Charge(COST_MINOR_FAULT);
+
+    // The last page mapping a shared frame simply takes it over
+    FrameInfo* info = Memsim_GetFrameInfo(shared);
+    if (info->mapCount == 1) {
+        if (shared == zeroFrame) {
+            zeroFrame = -1;
+        }
+        PTRmapRemove(shared, pid, VPN);
+        PTSetFrameOwner(shared, pid, VPN);
+        return pa;
+    }
+
+    int protection = PT_GetWritePerm(pid, VPN);
+    int pfn = PTClaimFrame(pid);
+    if (pfn == -1) {
+        return -1;
+    }
+    char* physmem = Memsim_GetPhysMem();
+    PageOps_Copy(&physmem[PAGE_START(pfn)], &physmem[PAGE_START(shared)], PAGE_SIZE);
+    if (shared == zeroFrame) {
+        Cost_Charge(COST_ZERO_FILL);
+    }
+    Memsim_MarkDirty(pfn);
+    PTSetFrameOwner(pfn, pid, VPN);
+    PTFinishEvictions();
+    PT_SetPTE(pid, VPN, pfn, 1, protection, 1, 1);
+    MMU_TLBInvalidate(pid, VPN);
+    PTPutSharedFrame(shared, pid, VPN);
+    return PAGE_START(pfn) + PAGE_OFFSET(pa);
+}
+
+/* Policy filter: frames of a NUMA node. */
+int PTFrameOnNode(int pfn, int node) {
+    return Memsim_NodeOf(pfn) == node;
+}
+
+/*
+ * Moves the private data page in a frame to a NUMA node: copies it to a free frame of the
+ * node (evicting a page of the node if it has none), repoints its entry, keeping its
+ * flags, and frees the old frame. Only done while the owner's page table is resident.
+ * The page and the page table are pinned. Returns the new frame, or -1 if it cannot move.
+ */
+int PT_MigratePage(int pfn, int node) {
+    FrameInfo* info = Memsim_GetFrameInfo(pfn);
+    Process* owner = Proc_Lookup(info->pid);
+    if (owner == NULL || !owner->ptPresent || info->vpn < 0 || info->mapCount > 0) {
+        return -1;
+    }
+    Memsim_Pin(pfn);
+    Memsim_Pin(PFN(owner->ptStartPA));
+    int target = Memsim_AllocFrameOnNode(node);
+    if (target == -1 && (target = PT_EvictFrom(PTFrameOnNode, node)) != -1) {
+        Stats_DirectReclaim();
+    }
+    if (target == -1) {
+        return -1;
+    }
+    char* physmem = Memsim_GetPhysMem();
+    PageOps_Copy(&physmem[PAGE_START(target)], &physmem[PAGE_START(pfn)], PAGE_SIZE);
+    Memsim_MarkDirty(target);
+    Memsim_CopyFrame(target, pfn);
+    Memsim_GetFrameInfo(target)->remoteAccesses = 0;
+    Policy_FrameMoved(target);
+    PTFinishEvictions();
+
+    int entry = PTEntryPA(info->pid, info->vpn);
+    physmem[entry + 1] = target & 0xFF;
+    physmem[entry + 2] = (target >> 8) & 0xFF;
+    physmem[entry + 3] = (target >> 16) & 0xFF;
+    Memsim_MarkDirty(PFN(entry));
+    MMU_TLBInvalidate(info->pid, info->vpn);
+    Memsim_FreePFN(pfn);
+    return target;
+}
+
+/*
+ * Merges the data page in frame dup into frame keep, which must hold the same bytes: the
+ * page's entry is pointed at keep, which becomes (or already is) a shared frame, and dup
+ * is freed. The page's table must be resident. Stores to either page later break COW.
+ */
+void PT_MergeFrames(int keep, int dup) {
+    FrameInfo victim = *Memsim_GetFrameInfo(dup);
+    if (Memsim_GetFrameInfo(keep)->mapCount == 0) {
+        PTShareFrame(keep);
+    }
+
+    char* physmem = Memsim_GetPhysMem();
+    int entry = PTEntryPA(victim.pid, victim.vpn);
+    int protection = (physmem[entry] & PTE_WRITE) ? 1 : 0;
+    int referenced = (physmem[entry] & PTE_REFERENCED) ? 1 : 0;
+    PT_SetPTE(victim.pid, victim.vpn, keep, 1, protection, 1, referenced);
+    MMU_TLBInvalidate(victim.pid, victim.vpn);
+    PTRmapAdd(keep, victim.pid, victim.vpn);
+
+    Stats_FrameReleased(victim.pid);
+    Memsim_FreePFN(dup);
+}
+
+/* Saves the dedup setting, the zero frame and the reverse map of every shared frame. */
+void PT_Checkpoint(FILE* file) {
+    Checkpoint_Write(file, &dedupEnabled, sizeof(dedupEnabled));
+    Checkpoint_Write(file, &zeroFrame, sizeof(zeroFrame));
+    for (int pfn = 0; pfn < NUM_FRAMES; pfn++) {
+        int count = 0;
+        for (RmapEntry* node = rmap[pfn]; node != NULL; node = node->next) {
+            count++;
+        }
+        Checkpoint_Write(file, &count, sizeof(count));
+        for (RmapEntry* node = rmap[pfn]; node != NULL; node = node->next) {
+            int mapping[2] = { node->pid, node->vpn };
+            Checkpoint_Write(file, mapping, sizeof(mapping));
+        }
+    }
+    Checkpoint_Write(file, &numParkedPTEs, sizeof(numParkedPTEs));
+    Checkpoint_Write(file, parkedPTEs, numParkedPTEs * sizeof(pendingPTE));
+}
+
+/* Restores what PT_Checkpoint saved. Frame map counts are restored with the frames. */
+int PT_Restore(CheckpointReader* reader) {
+    numPendingPTEs = 0;
+    if (!Checkpoint_ReadInto(reader, &dedupEnabled, sizeof(dedupEnabled))
+        || !Checkpoint_ReadInto(reader, &zeroFrame, sizeof(zeroFrame))) {
+        return FALSE;
+    }
+    Pool_Reset(&rmapPool);
+    for (int pfn = 0; pfn < NUM_FRAMES; pfn++) {
+        rmap[pfn] = NULL;
+        int count;
+        if (!Checkpoint_ReadInto(reader, &count, sizeof(count))) {
+            return FALSE;
+        }
+        RmapEntry** tail = &rmap[pfn];
+        for (int i = 0; i < count; i++) {
+            int mapping[2];
+            if (!Checkpoint_ReadInto(reader, mapping, sizeof(mapping))) {
+                return FALSE;
+            }
+            RmapEntry* node = Pool_Alloc(&rmapPool);
+            node->pid = mapping[0];
+            node->vpn = mapping[1];
+            node->next = NULL;
+            *tail = node;
+            tail = &node->next;
+        }
+    }
+    int count;
+    if (!Checkpoint_ReadInto(reader, &count, sizeof(count))) {
+        return FALSE;
+    }
+    numParkedPTEs = 0;
+    for (int i = 0; i < count; i++) {
+        pendingPTE update;
+        if (!Checkpoint_ReadInto(reader, &update, sizeof(update))) {
+            return FALSE;
+        }
+        PTPark(update);
     }
+    return TRUE;
 }
@@ -1,36 +1,70 @@
 // Starting code version 1.1
 
+#ifndef PAGETABLE_H
+#define PAGETABLE_H
+
+#include <stdio.h>
+
+#include "policy.h"
+#include "checkpoint.h"
+
 /*
  * Public Interface:
  */
 
-#define NUM_PROCESSES 4
-
 /*
- * Public Interface:
+ * Page table entries are stored in simulated physical memory, PTE_SIZE bytes each:
+ * one byte of PTE_* flags followed by a 24-bit little endian number that is the
+ * frame when the page is present, or the swap slot when it has been swapped out.
+ * A page swapped out as same-filled has PTE_SAMEFILLED set and its fill byte in place
+ * of the swap slot. PTE_DIRTY is set by a store and cleared whenever the entry is
+ * rewritten, e.g. when the page is swapped back in.
  */
+#define PTE_SIZE 4
+#define PTE_VALID 0x01
+#define PTE_WRITE 0x02
+#define PTE_PRESENT 0x04
+#define PTE_REFERENCED 0x08
+#define PTE_SAMEFILLED 0x10
+#define PTE_DIRTY 0x20
+
+// Levels walked on a TLB miss: a process's page table is a single frame
+#define PT_LEVELS 1
+
+typedef struct {
+    int PFN;         // Page frame number (swap slot when not present)
+    int valid;       // Valid bit
+    int protection;  // Read/write permissions
+    int present;     // In memory or swapped out
+    int referenced;  // Referenced since the bit was last cleared
+    int rw_bit;      // Read/Write permission bit
+    int sameFilled;  // Swapped out as a same-filled page, PFN is the fill byte
+    int dirty;       // Stored to since the entry was last written
+} PageTableEntry;
+
 void PT_SetPTE(int process_id, int VPN, int PFN, int valid, int protection, int present, int referenced);
+PageTableEntry* PT_GetPTE(int pid, int vpn);
 int PT_PageTableInit(int process_id, int pageAddress);
 int PT_PageTableExists(int process_id);
 int PT_GetRootPtrRegVal(int process_id);
 int PT_Evict();
+int PT_EvictFrom(PolicyFilter filter, int arg);
 int PT_VPNtoPA(int process_id, int VPN);
+int PT_TranslateForAccess(int process_id, int VPN, int access);
+int PT_Prefetch(int pid, int VPN);
 int PT_PIDHasWritePerm(int process_id, int VPN);
 void PT_Init();
-int PT_Map(int process_id, int VPN, int frame);
+void PT_SetDedup(int enabled);
+int PT_BreakCOW(int pid, int VPN, int pa);
+void PT_MergeFrames(int keep, int dup);
+int PT_MigratePage(int pfn, int node);
+void PT_Checkpoint(FILE* file);
+int PT_Restore(CheckpointReader* reader);
+int PT_Map(int process_id, int VPN, int protection);
 void PT_PageTableCreate(int pid, int pfn);
-<<<<<<< HEAD
 int PT_GetWritePerm(int pid, int vpn);
 void PT_UpdateWritePerm(int pid, int vpn, int new_perm);
-typedef struct {
-    int PFN;         // Page frame number
-    int valid;       // Valid bit
-    int protection;  // Read/write permissions
-    int present;     // In memory or swapped out
-    int referenced;  // Last access or swap offset
-    int rw_bit;      // Read/Write permission bit
-} PageTableEntry;
+int PT_TestAndClearReferenced(int pid, int VPN);
+int PT_DestroyProcess(int pid, int* framesFreed, int* slotsFreed);
 
-PageTableEntry* PT_GetPTE(int pid, int vpn); // Function prototype
-=======
->>>>>>> 6e52b80ec79db43d862435d37c7e1c431f5261ca
+#endif // PAGETABLE_H
@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipeline.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "input.h"
+#include "process.h"
+#include "kswapd.h"
+#include "ksm.h"
+#include "cost.h"
+
+/* Private Internals: */
+
+#define PIPELINE_MAX_WINDOW 256
+#define PIPELINE_MAX_DEPTH PIPELINE_MAX_WINDOW
+
+// A line read ahead. The lines of a process run in input order, but while one of them
+// waits on its swap I/O, later lines of other processes run. Lines that are not
+// instructions of a process (checkpoints, malformed lines) wait for every older line and
+// its I/O, and hold back every newer one.
+typedef struct {
+    char text[MAX_GETLINE_CHARS];
+    int pid;                        // -1 if not an instruction of a process
+} PipelineLine;
+
+int pipelineEnabled = FALSE;
+PipelineSpec pipelineSpec;
+
+PipelineLine pipelineLines[PIPELINE_MAX_WINDOW];   // Oldest first
+int numPipelineLines = 0;
+
+// Modeled time each process's last swap I/O completes, before which its next line waits
+long* pipelineReadyAt = NULL;
+
+// Modeled time each device queue slot is free again. A line's swap I/O takes the first free one.
+long pipelineDevice[PIPELINE_MAX_DEPTH];
+
+// Marks the processes with an older line still queued while looking for the next line
+int* pipelineSeen = NULL;
+int pipelineStamp = 0;
+
+// Modeled time, in the cycles the cost model charges. The CPU runs one line at a time and
+// pays for everything but swap I/O (major faults and write-backs), which the device does
+// while the CPU runs other processes' lines. In order, every cycle would stall the CPU.
+long pipelineClock = 0;
+long pipelineSerialClock = 0;
+long pipelineIdle = 0;          // Cycles with every queued line waiting on swap I/O
+long pipelineIOCycles = 0;
+long pipelineInstructions = 0;
+long pipelineWaits = 0;         // Lines that suspended their process on swap I/O
+long pipelineOvertaken = 0;     // Lines run while an older line was waiting
+
+/* Reads the next line into the window. Returns FALSE at the end of the input. */
+int PipelineReadLine() {
+    char* text;
+    if (Input_GetLine(&text) < 1) {
+        return FALSE;
+    }
+    PipelineLine* line = &pipelineLines[numPipelineLines++];
+    strcpy(line->text, text);
+    int vpns[VPN(VIRTUAL_SIZE)];
+    if (Input_LinePages(line->text, &line->pid, vpns) == -1) {
+        line->pid = -1;
+    }
+    return TRUE;
+}
+
+/* Modeled time every swap I/O started so far completes. */
+long PipelineDrained() {
+    long drained = pipelineClock;
+    for (int i = 0; i < pipelineSpec.depth; i++) {
+        if (pipelineDevice[i] > drained) {
+            drained = pipelineDevice[i];
+        }
+    }
+    return drained;
+}
+
+/*
+ * The oldest line that may run now: the first line of its process in the window, with
+ * its process's swap I/O done and no barrier before it. Returns -1 if every one waits.
+ */
+int PipelinePick() {
+    pipelineStamp++;
+    for (int i = 0; i < numPipelineLines; i++) {
+        PipelineLine* line = &pipelineLines[i];
+        if (line->pid == -1) {
+            return (i == 0 && PipelineDrained() <= pipelineClock) ? 0 : -1;
+        }
+        if (pipelineSeen[line->pid] == pipelineStamp) {
+            continue;
+        }
+        pipelineSeen[line->pid] = pipelineStamp;
+        if (pipelineReadyAt[line->pid] <= pipelineClock) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Idles the CPU until the first process the window waits on has its swap I/O done. */
+void PipelineWait() {
+    long next = -1;
+    for (int i = 0; i < numPipelineLines; i++) {
+        int pid = pipelineLines[i].pid;
+        long readyAt = (pid == -1) ? PipelineDrained() : pipelineReadyAt[pid];
+        if (readyAt > pipelineClock && (next == -1 || readyAt < next)) {
+            next = readyAt;
+        }
+        if (pid == -1) {
+            break; // Nothing past a barrier runs before it
+        }
+    }
+    if (next != -1) {
+        pipelineIdle += next - pipelineClock;
+        pipelineClock = next;
+    }
+}
+
+/* Swap I/O cycles charged so far: swap file reads and writes. */
+long PipelineIOCycles() {
+    return Cost_Events(COST_MAJOR_FAULT) * Cost_EventCycles(COST_MAJOR_FAULT)
+         + Cost_Events(COST_WRITEBACK) * Cost_EventCycles(COST_WRITEBACK);
+}
+
+/*
+ * Queues swap I/O of a process on the first device slot free. The process waits until it
+ * completes; the CPU does not.
+ */
+void PipelineSubmit(int pid, long cycles) {
+    int slot = 0;
+    for (int i = 1; i < pipelineSpec.depth; i++) {
+        if (pipelineDevice[i] < pipelineDevice[slot]) {
+            slot = i;
+        }
+    }
+    long start = (pipelineDevice[slot] > pipelineClock) ? pipelineDevice[slot] : pipelineClock;
+    pipelineDevice[slot] = start + cycles;
+    if (pid != -1) {
+        pipelineReadyAt[pid] = pipelineDevice[slot];
+    }
+    pipelineWaits++;
+}
+
+/*
+ * Runs a line as MMUStart would. The cycles the cost model charges for it go on the CPU,
+ * except its swap I/O, which suspends its process instead.
+ */
+void PipelineRunLine(int index) {
+    PipelineLine line = pipelineLines[index];
+    memmove(&pipelineLines[index], &pipelineLines[index + 1],
+            (numPipelineLines - index - 1) * sizeof(PipelineLine));
+    numPipelineLines--;
+    pipelineOvertaken += (index > 0);
+
+    long cycles = Cost_Total();
+    long io = PipelineIOCycles();
+    MMU_LockMM();
+    Input_NextInstruction(line.text);
+    Kswapd_Poke();
+    Ksm_Poke();
+    MMU_UnlockMM();
+    cycles = Cost_Total() - cycles;
+    io = PipelineIOCycles() - io;
+
+    pipelineClock += cycles - io;
+    pipelineSerialClock += cycles;
+    pipelineIOCycles += io;
+    if (io > 0) {
+        PipelineSubmit(line.pid, io);
+    }
+    pipelineInstructions += (line.pid != -1);
+}
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Reads async pipeline settings from a comma separated key=value list:
+ *   window=lines depth=device queue slots
+ * Returns FALSE (after printing why) if they are invalid.
+ */
+int Pipeline_Parse(const char* spec, PipelineSpec* out) {
+    out->enabled = TRUE;
+    out->window = 16;
+    out->depth = 16;
+
+    char* copy = strdup(spec);
+    int ok = TRUE;
+    char* save;
+    for (char* item = strtok_r(copy, ",", &save); item != NULL && ok; item = strtok_r(NULL, ",", &save)) {
+        char* value = strchr(item, '=');
+        if (value == NULL) {
+            ok = FALSE;
+            break;
+        }
+        *value++ = '\0';
+        if (strcmp(item, "window") == 0) {
+            out->window = atoi(value);
+        } else if (strcmp(item, "depth") == 0) {
+            out->depth = atoi(value);
+        } else {
+            ok = FALSE;
+        }
+    }
+    free(copy);
+
+    if (!ok || out->window < 1 || out->window > PIPELINE_MAX_WINDOW || out->depth < 1
+        || out->depth > PIPELINE_MAX_DEPTH) {
+        printf("Invalid async pipeline '%s'. Use key=value pairs among window (lines, 1-%d) " \
+               "and depth (swap I/O in flight, 1-%d).\n", spec, PIPELINE_MAX_WINDOW, PIPELINE_MAX_DEPTH);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Sets the pipeline up. Its time comes from the cost model, which must be enabled too. */
+void Pipeline_Init(const PipelineSpec* spec) {
+    pipelineEnabled = spec->enabled;
+    pipelineSpec = *spec;
+    numPipelineLines = 0;
+    memset(pipelineDevice, 0, sizeof(pipelineDevice));
+    pipelineClock = pipelineSerialClock = pipelineIdle = pipelineIOCycles = 0;
+    pipelineInstructions = pipelineWaits = pipelineOvertaken = 0;
+    if (pipelineEnabled && pipelineSeen == NULL) {
+        pipelineSeen = calloc(MAX_PID + 1, sizeof(int));
+        pipelineReadyAt = calloc(MAX_PID + 1, sizeof(long));
+    }
+}
+
+int Pipeline_Enabled() {
+    return pipelineEnabled;
+}
+
+/*
+ * Reads and runs the input like MMUStart, a window of lines at a time. A line that
+ * reads or writes the swap file suspends its process until the device completes the
+ * I/O, after the cycles the cost model charges for it; meanwhile the next lines of other
+ * processes run. The lines of each process still run in input order.
+ */
+int Pipeline_Run() {
+    int eof = FALSE;
+    while (TRUE) {
+        while (!eof && numPipelineLines < pipelineSpec.window) {
+            eof = !PipelineReadLine();
+        }
+        if (numPipelineLines == 0) {
+            break;
+        }
+        int index = PipelinePick();
+        if (index == -1) {
+            PipelineWait();
+            continue;
+        }
+        PipelineRunLine(index);
+    }
+    // The run ends when the last swap I/O does
+    long drained = PipelineDrained();
+    pipelineIdle += drained - pipelineClock;
+    pipelineClock = drained;
+    printf("End of File.\n");
+    return 0;
+}
+
+void Pipeline_Report() {
+    if (!pipelineEnabled) {
+        return;
+    }
+    printf("Async pipeline: %ld instructions, %ld waited on swap I/O (%ld cycles), " \
+           "%ld lines run past a waiting one\n",
+           pipelineInstructions, pipelineWaits, pipelineIOCycles, pipelineOvertaken);
+    printf("Pipeline time: %ld cycles (%ld idle) against %ld in order, %.2fx throughput\n",
+           pipelineClock, pipelineIdle, pipelineSerialClock,
+           pipelineClock > 0 ? (double)pipelineSerialClock / pipelineClock : 1.0);
+}
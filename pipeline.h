@@ -0,0 +1,21 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+/*
+ * Public Interface:
+ */
+
+/* Look-ahead and device queue of the async pipeline, from an --async key=value list. */
+typedef struct {
+    int enabled;
+    int window;      // Lines read ahead of the oldest one not yet run
+    int depth;       // Swap I/O in flight at once, one line's worth each
+} PipelineSpec;
+
+int Pipeline_Parse(const char* spec, PipelineSpec* out);
+void Pipeline_Init(const PipelineSpec* spec);
+int Pipeline_Enabled();
+int Pipeline_Run();
+void Pipeline_Report();
+
+#endif // PIPELINE_H
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "policy.h"
+#include "memsim.h"
+#include "checkpoint.h"
+#include "opt.h"
+
+/* Private Internals: */
+
+int activePolicy = POLICY_RR;
+
+// Next frame the round robin / clock hand looks at. Frame 0 holds the first
+// page table, so the hand starts just past it.
+int policyHand = 1;
+
+// Counts frame accesses, to stamp each frame with the time of its last access for LRU
+long policyTime = 0;
+
+const char* policyNames[POLICY_COUNT] = { "rr", "clock", "lru", "lfu", "opt" };
+
+/*
+ * Moves the hand to the next frame that may be evicted, wrapping around at most once, and
+ * counts the frames it passed in steps. Returns that frame (the hand is left just past
+ * it), or -1 if there is none. Frames that are free, pinned or shared are skipped a
+ * bitmap word at a time.
+ */
+int PolicyAdvance(int* steps) {
+    int from = policyHand;
+    int pfn = Memsim_NextEvictable(from);
+    if (pfn == -1) {
+        pfn = Memsim_NextEvictable(0);
+    }
+    if (pfn == -1) {
+        return -1;
+    }
+    *steps += (pfn - from + NUM_FRAMES) % NUM_FRAMES + 1;
+    policyHand = (pfn + 1) % NUM_FRAMES;
+    return pfn;
+}
+
+/* Round robin: the next claimed, unpinned frame after the hand. */
+int PolicySelectRR(PolicyFilter filter, int arg) {
+    int start = policyHand, steps = 0;
+    for (int pfn = PolicyAdvance(&steps); pfn != -1 && steps <= NUM_FRAMES; pfn = PolicyAdvance(&steps)) {
+        if (filter == NULL || filter(pfn, arg)) {
+            return pfn;
+        }
+    }
+    policyHand = start; // went all the way round
+    return -1;
+}
+
+/*
+ * Clock: sweeps the hand, spending one chance of each referenced frame, and picks the
+ * first frame without any left. A page table frame is given POLICY_PT_BOOST chances when
+ * accessed, so it is only evicted once its process has been idle for a few sweeps.
+ */
+int PolicySelectClock(PolicyFilter filter, int arg) {
+    // Every frame can hold at most 1 + POLICY_PT_BOOST chances
+    int start = policyHand, steps = 0;
+    for (int pfn = PolicyAdvance(&steps); pfn != -1 && steps <= NUM_FRAMES * (POLICY_PT_BOOST + 2);
+         pfn = PolicyAdvance(&steps)) {
+        if (filter != NULL && !filter(pfn, arg)) {
+            continue;
+        }
+        int chances = Memsim_GetReferenced(pfn);
+        if (chances > 0) {
+            Memsim_SetReferenced(pfn, chances - 1);
+            continue;
+        }
+        return pfn;
+    }
+    policyHand = start;
+    return -1;
+}
+
+/* Least recently used: the frame whose last access is the oldest. */
+int PolicySelectLRU(PolicyFilter filter, int arg) {
+    int victim = -1;
+    for (int pfn = Memsim_NextEvictable(0); pfn != -1; pfn = Memsim_NextEvictable(pfn + 1)) {
+        if ((filter == NULL || filter(pfn, arg))
+            && (victim == -1 || Memsim_GetLastUse(pfn) < Memsim_GetLastUse(victim))) {
+            victim = pfn;
+        }
+    }
+    return victim;
+}
+
+/*
+ * Least frequently used: the frame accessed the fewest times since it was filled, and
+ * the least recently used among those.
+ */
+int PolicySelectLFU(PolicyFilter filter, int arg) {
+    int victim = -1;
+    for (int pfn = Memsim_NextEvictable(0); pfn != -1; pfn = Memsim_NextEvictable(pfn + 1)) {
+        if (filter != NULL && !filter(pfn, arg)) {
+            continue;
+        }
+        if (victim == -1 || Memsim_GetUses(pfn) < Memsim_GetUses(victim)
+            || (Memsim_GetUses(pfn) == Memsim_GetUses(victim) && Memsim_GetLastUse(pfn) < Memsim_GetLastUse(victim))) {
+            victim = pfn;
+        }
+    }
+    return victim;
+}
+
+/*
+ * Public Interface:
+ */
+
+void Policy_Init(int policy) {
+    activePolicy = policy;
+    policyHand = 1 % NUM_FRAMES;
+    policyTime = 0;
+}
+
+int Policy_GetPolicy() {
+    return activePolicy;
+}
+
+/*
+ * Changes the policy choosing the next victims. Every policy keeps its state of each
+ * frame up to date whichever is active, so the new one starts from what it has seen.
+ */
+void Policy_SetPolicy(int policy) {
+    activePolicy = policy;
+}
+
+/* Maps a policy name given on the command line to its id, or -1 if unknown. */
+int Policy_FromName(const char* name) {
+    for (int policy = 0; policy < POLICY_COUNT; policy++) {
+        if (strcmp(name, policyNames[policy]) == 0) {
+            return policy;
+        }
+    }
+    return -1;
+}
+
+const char* Policy_Name(int policy) {
+    return policyNames[policy];
+}
+
+/* Records a use of a frame, either by a page table walk or a data access. */
+void Policy_FrameAccessed(int pfn) {
+    int chances = (Memsim_GetFrameInfo(pfn)->vpn == FRAME_VPN_PAGETABLE) ? 1 + POLICY_PT_BOOST : 1;
+    if (Memsim_GetReferenced(pfn) < chances) {
+        Memsim_SetReferenced(pfn, chances);
+    }
+    Memsim_SetUse(pfn, ++policyTime, Memsim_GetUses(pfn) + 1);
+    Opt_FrameAccessed(pfn);
+}
+
+/* Forgets the accesses to a frame, so that every policy evicts it first (an unused prefetch). */
+void Policy_FrameUnused(int pfn) {
+    Memsim_SetReferenced(pfn, 0);
+    Memsim_SetUse(pfn, 0, 0);
+}
+
+/* Follows a page moved to another frame, whose state came along with it (Memsim_CopyFrame). */
+void Policy_FrameMoved(int pfn) {
+    Opt_FrameAccessed(pfn);
+}
+
+/*
+ * Chooses the frame to evict next among the frames accepted by the filter (any frame if
+ * it is NULL). Page tables and data pages compete for frames alike, shared frames are
+ * never chosen.
+ * Returns -1 if every eligible frame is pinned.
+ */
+int Policy_SelectVictim(PolicyFilter filter, int arg) {
+    switch (activePolicy) {
+    case POLICY_CLOCK:
+        return PolicySelectClock(filter, arg);
+    case POLICY_LRU:
+        return PolicySelectLRU(filter, arg);
+    case POLICY_LFU:
+        return PolicySelectLFU(filter, arg);
+    case POLICY_OPT:
+        return Opt_SelectVictim(filter, arg);
+    default:
+        return PolicySelectRR(filter, arg);
+    }
+}
+
+void Policy_Checkpoint(FILE* file) {
+    Checkpoint_Write(file, &activePolicy, sizeof(activePolicy));
+    Checkpoint_Write(file, &policyHand, sizeof(policyHand));
+    Checkpoint_Write(file, &policyTime, sizeof(policyTime));
+}
+
+int Policy_Restore(CheckpointReader* reader) {
+    return Checkpoint_ReadInto(reader, &activePolicy, sizeof(activePolicy))
+        && Checkpoint_ReadInto(reader, &policyHand, sizeof(policyHand))
+        && Checkpoint_ReadInto(reader, &policyTime, sizeof(policyTime))
+        && activePolicy >= 0 && activePolicy < POLICY_COUNT
+        && (activePolicy != POLICY_OPT || Opt_Enabled());
+}
@@ -0,0 +1,39 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <stdio.h>
+
+#include "checkpoint.h"
+
+/*
+ * Public Interface:
+ */
+
+// Replacement policies
+#define POLICY_RR 0      // Round robin over all frames (the autotest *RR reference behavior)
+#define POLICY_CLOCK 1   // Second chance, page table frames get extra chances
+#define POLICY_LRU 2     // Least recently used frame
+#define POLICY_LFU 3     // Least frequently used frame since it was filled
+#define POLICY_ONLINE 4  // Policies above decide from the past only
+#define POLICY_OPT 4     // Frame used furthest in the future (needs the whole input first)
+#define POLICY_COUNT 5
+
+// Extra CLOCK chances given to a frame holding a page table
+#define POLICY_PT_BOOST 2
+
+// Restricts victim selection to frames for which the filter returns true
+typedef int (*PolicyFilter)(int pfn, int arg);
+
+void Policy_Init(int policy);
+int Policy_GetPolicy();
+void Policy_SetPolicy(int policy);
+int Policy_FromName(const char* name);
+const char* Policy_Name(int policy);
+void Policy_FrameAccessed(int pfn);
+void Policy_FrameUnused(int pfn);
+void Policy_FrameMoved(int pfn);
+int Policy_SelectVictim(PolicyFilter filter, int arg);
+void Policy_Checkpoint(FILE* file);
+int Policy_Restore(CheckpointReader* reader);
+
+#endif // POLICY_H
@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "process.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "checkpoint.h"
+#include "arena.h"
+
+/* Private Internals: */
+
+#define PROC_INITIAL_BUCKETS 16
+
+Process** procBuckets = NULL;
+int numProcBuckets = 0;
+int numProcs = 0;
+
+// Contexts and their per VPN reference histories, recycled as processes come and go
+Pool procPool;
+Pool referencePool;
+
+// All processes in creation order, for reports and teardown
+Process* procListHead = NULL;
+Process* procListTail = NULL;
+
+/* Resident memory limits configured for a pid (or every pid) before it exists. */
+typedef struct {
+    int pid;              // -1 for the default of every process
+    int hardLimit;
+    int softLimit;
+} ProcLimits;
+
+ProcLimits* procLimits = NULL;
+int numProcLimits = 0;
+
+/*
+ * NUMA placement configured for a pid (or every pid) before it exists. It comes from the
+ * command line of each run, so unlike the limits it is not saved in checkpoints.
+ */
+typedef struct {
+    int pid;              // -1 for the default of every process
+    int policy;
+    int node;
+} ProcPlacement;
+
+ProcPlacement* procPlacements = NULL;
+int numProcPlacements = 0;
+
+// Next address space id to hand out in the current generation (0 is never used)
+int nextASID = 1;
+int asidGeneration = 1;
+
+int ProcHash(int pid) {
+    unsigned int h = (unsigned int)pid * 2654435761u;
+    return h & (numProcBuckets - 1);
+}
+
+/*
+ * Doubles the bucket array once the table is three quarters full. The old array stays in
+ * the arena; the arrays left behind add up to less than the current one.
+ */
+void ProcGrow() {
+    Process** oldBuckets = procBuckets;
+    int oldCount = numProcBuckets;
+
+    numProcBuckets = oldCount * 2;
+    procBuckets = Arena_Alloc(numProcBuckets * sizeof(Process*));
+    for (int i = 0; i < oldCount; i++) {
+        Process* proc = oldBuckets[i];
+        while (proc != NULL) {
+            Process* next = proc->hashNext;
+            int b = ProcHash(proc->pid);
+            proc->hashNext = procBuckets[b];
+            procBuckets[b] = proc;
+            proc = next;
+        }
+    }
+}
+
+/*
+ * Public Interface:
+ */
+
+/* Tears down every process at once. The bucket array is kept at the size it grew to. */
+void Proc_Init() {
+    if (procBuckets == NULL) {
+        Pool_Init(&procPool, sizeof(Process));
+        Pool_Init(&referencePool, VPN(VIRTUAL_SIZE) * sizeof(long));
+        numProcBuckets = PROC_INITIAL_BUCKETS;
+        procBuckets = Arena_Alloc(numProcBuckets * sizeof(Process*));
+    }
+    Pool_Reset(&procPool);
+    Pool_Reset(&referencePool);
+    memset(procBuckets, 0, numProcBuckets * sizeof(Process*));
+    numProcs = 0;
+    procListHead = NULL;
+    procListTail = NULL;
+    nextASID = 1;
+    asidGeneration = 1;
+}
+
+/* Finds the context of a pid. Returns NULL if the process does not exist. */
+Process* Proc_Lookup(int pid) {
+    for (Process* proc = procBuckets[ProcHash(pid)]; proc != NULL; proc = proc->hashNext) {
+        if (proc->pid == pid) {
+            return proc;
+        }
+    }
+    return NULL;
+}
+
+/* Finds the context of a pid, creating it on the first reference to the process. */
+Process* Proc_Get(int pid) {
+    Process* proc = Proc_Lookup(pid);
+    if (proc != NULL) {
+        return proc;
+    }
+
+    if (numProcs + 1 > numProcBuckets * 3 / 4) {
+        ProcGrow();
+    }
+    proc = Pool_Alloc(&procPool);
+    proc->pid = pid;
+    proc->ptStartPA = -1;
+    proc->ptPresent = 0;
+    proc->asidGeneration = 0; // assigned on first translation
+    Readahead_InitState(&proc->readahead);
+    for (int i = 0; i < numProcLimits; i++) { // later, pid specific settings win
+        if (procLimits[i].pid == -1 || procLimits[i].pid == pid) {
+            proc->hardLimit = procLimits[i].hardLimit;
+            proc->softLimit = procLimits[i].softLimit;
+        }
+    }
+    for (int i = 0; i < numProcPlacements; i++) {
+        if (procPlacements[i].pid == -1 || procPlacements[i].pid == pid) {
+            proc->numaPolicy = procPlacements[i].policy;
+            proc->numaNode = procPlacements[i].node;
+        }
+    }
+    proc->stats.lastReference = Pool_Alloc(&referencePool);
+    for (int vpn = 0; vpn < VPN(VIRTUAL_SIZE); vpn++) {
+        proc->stats.lastReference[vpn] = -1;
+    }
+
+    int b = ProcHash(pid);
+    proc->hashNext = procBuckets[b];
+    procBuckets[b] = proc;
+
+    proc->listPrev = procListTail;
+    if (procListTail != NULL) {
+        procListTail->listNext = proc;
+    } else {
+        procListHead = proc;
+    }
+    procListTail = proc;
+    numProcs++;
+    return proc;
+}
+
+/* Removes a process context. Its memory must already have been released. */
+void Proc_Destroy(int pid) {
+    Process** link = &procBuckets[ProcHash(pid)];
+    while (*link != NULL && (*link)->pid != pid) {
+        link = &(*link)->hashNext;
+    }
+    Process* proc = *link;
+    if (proc == NULL) {
+        return;
+    }
+    *link = proc->hashNext;
+
+    if (proc->listPrev != NULL) {
+        proc->listPrev->listNext = proc->listNext;
+    } else {
+        procListHead = proc->listNext;
+    }
+    if (proc->listNext != NULL) {
+        proc->listNext->listPrev = proc->listPrev;
+    } else {
+        procListTail = proc->listPrev;
+    }
+    if (proc->asidGeneration == asidGeneration) {
+        MMU_TLBFlushASID(proc->asid);
+    }
+    Pool_Free(&referencePool, proc->stats.lastReference);
+    Pool_Free(&procPool, proc);
+    numProcs--;
+}
+
+/*
+ * Gets the address space id of a process, assigning one if it has none in the current
+ * generation. Running out of ids starts a new generation, which flushes the whole TLB.
+ */
+int Proc_GetASID(Process* proc) {
+    if (proc->asidGeneration != asidGeneration) {
+        if (nextASID == NUM_ASIDS) {
+            asidGeneration++;
+            nextASID = 1;
+            MMU_TLBFlushAll();
+        }
+        proc->asid = nextASID++;
+        proc->asidGeneration = asidGeneration;
+    }
+    return proc->asid;
+}
+
+/*
+ * Limits the resident frames of a pid, or of every process if pid is -1. Applies to the
+ * process if it exists and to every later process with that pid. 0 means unlimited.
+ */
+void Proc_SetLimits(int pid, int hardLimit, int softLimit) {
+    procLimits = realloc(procLimits, (numProcLimits + 1) * sizeof(ProcLimits));
+    procLimits[numProcLimits].pid = pid;
+    procLimits[numProcLimits].hardLimit = hardLimit;
+    procLimits[numProcLimits].softLimit = softLimit;
+    numProcLimits++;
+
+    for (Process* proc = procListHead; proc != NULL; proc = proc->listNext) {
+        if (pid == -1 || proc->pid == pid) {
+            proc->hardLimit = hardLimit;
+            proc->softLimit = softLimit;
+        }
+    }
+}
+
+/* Sets the NUMA placement policy of a pid (or of every pid if -1), now and when created. */
+void Proc_SetPlacement(int pid, int policy, int node) {
+    procPlacements = realloc(procPlacements, (numProcPlacements + 1) * sizeof(ProcPlacement));
+    procPlacements[numProcPlacements].pid = pid;
+    procPlacements[numProcPlacements].policy = policy;
+    procPlacements[numProcPlacements].node = node;
+    numProcPlacements++;
+
+    for (Process* proc = procListHead; proc != NULL; proc = proc->listNext) {
+        if (pid == -1 || proc->pid == pid) {
+            proc->numaPolicy = policy;
+            proc->numaNode = node;
+        }
+    }
+}
+
+/* Whether any soft or hard limit was set, so eviction has to look at owners. */
+int Proc_LimitsConfigured() {
+    return numProcLimits > 0;
+}
+
+int Proc_Count() {
+    return numProcs;
+}
+
+/* Iterates processes in creation order. */
+Process* Proc_First() {
+    return procListHead;
+}
+
+Process* Proc_Next(Process* proc) {
+    return proc->listNext;
+}
+
+/*
+ * Saves the address space id allocator, the configured limits and every process in
+ * creation order, including its accounting and working set history.
+ */
+void Proc_Checkpoint(FILE* file) {
+    Checkpoint_Write(file, &nextASID, sizeof(nextASID));
+    Checkpoint_Write(file, &asidGeneration, sizeof(asidGeneration));
+    Checkpoint_Write(file, &numProcLimits, sizeof(numProcLimits));
+    Checkpoint_Write(file, procLimits, numProcLimits * sizeof(ProcLimits));
+    Checkpoint_Write(file, &numProcs, sizeof(numProcs));
+    for (Process* proc = procListHead; proc != NULL; proc = proc->listNext) {
+        Checkpoint_Write(file, proc, sizeof(Process));
+        Checkpoint_Write(file, proc->stats.lastReference, VPN(VIRTUAL_SIZE) * sizeof(long));
+    }
+}
+
+/* Replaces every process with the ones saved by Proc_Checkpoint. */
+int Proc_Restore(CheckpointReader* reader) {
+    Proc_Init();
+    int count;
+    if (!Checkpoint_ReadInto(reader, &nextASID, sizeof(nextASID))
+        || !Checkpoint_ReadInto(reader, &asidGeneration, sizeof(asidGeneration))
+        || !Checkpoint_ReadInto(reader, &numProcLimits, sizeof(numProcLimits))) {
+        return FALSE;
+    }
+    procLimits = realloc(procLimits, numProcLimits * sizeof(ProcLimits));
+    if (!Checkpoint_ReadInto(reader, procLimits, numProcLimits * sizeof(ProcLimits))
+        || !Checkpoint_ReadInto(reader, &count, sizeof(count))) {
+        return FALSE;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const Process* saved = Checkpoint_Read(reader, sizeof(Process));
+        const long* lastReference = Checkpoint_Read(reader, VPN(VIRTUAL_SIZE) * sizeof(long));
+        if (saved == NULL || lastReference == NULL) {
+            return FALSE;
+        }
+        // Take the saved contents but keep the links of the freshly inserted context
+        Process* proc = Proc_Get(saved->pid);
+        Process links = *proc;
+        *proc = *saved;
+        proc->hashNext = links.hashNext;
+        proc->listPrev = links.listPrev;
+        proc->listNext = links.listNext;
+        proc->stats.lastReference = links.stats.lastReference;
+        memcpy(proc->stats.lastReference, lastReference, VPN(VIRTUAL_SIZE) * sizeof(long));
+    }
+    return TRUE;
+}
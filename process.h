@@ -0,0 +1,73 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+/*
+ * Public Interface:
+ */
+
+#include <stdio.h>
+
+#include "readahead.h"
+#include "checkpoint.h"
+
+#define MAX_PID 65535
+
+// Address space ids tag TLB entries, so switching between processes needs no flush.
+// When they run out a new generation starts and every process gets a fresh id lazily.
+#define NUM_ASIDS 256
+
+/* Memory accounting of a process, see stats.c. */
+typedef struct {
+    long instructions;
+    long faults;          // Accesses that had to swap a page (or the page table) back in
+    long evictions;       // Pages of this process swapped out
+    long limitReclaims;   // Own pages evicted because the process was at its hard limit
+    long prefetches;      // Pages swapped in ahead of use by readahead
+    long prefetchHits;    // Prefetched pages that were used before being evicted
+    int rss;              // Resident frames, including the page table
+    int peakRss;
+    int swapPages;        // Pages (including the page table) currently in swap
+    long sampleInstructions;  // Counters at the last working set sample
+    long sampleFaults;
+    long* lastReference;  // Per VPN, instruction count at which it was last seen referenced
+    long localAccesses;   // Loads and stores to a frame on the node the process runs on
+    long remoteAccesses;
+    long accessCost;      // Sum of the NUMA distances of those accesses
+    long translations;    // Loads and stores translated, through the TLB or a walk
+    long cycles;          // Modeled time charged by the cost model
+} ProcStats;
+
+/* Per process context, looked up by pid in a growable hash table. */
+typedef struct Process {
+    int pid;
+    int asid;
+    int asidGeneration;
+    int ptStartPA;        // Page table register: start of the page table, or its swap offset
+    int ptPresent;        // Page table is resident in physical memory
+    int hardLimit;        // Max resident frames, reclaiming its own pages beyond it (0: none)
+    int softLimit;        // Resident frames above which its pages are evicted first (0: none)
+    int numaPolicy;       // NUMA_POLICY_* used to place its frames
+    int numaNode;         // Node of the preferred policy
+    int numaNext;         // Next node of the interleave policy
+    ProcStats stats;
+    ReadaheadState readahead;
+    struct Process* hashNext;
+    struct Process* listPrev;
+    struct Process* listNext;
+} Process;
+
+void Proc_Init();
+Process* Proc_Lookup(int pid);
+Process* Proc_Get(int pid);
+void Proc_Destroy(int pid);
+int Proc_GetASID(Process* proc);
+void Proc_SetLimits(int pid, int hardLimit, int softLimit);
+void Proc_SetPlacement(int pid, int policy, int node);
+int Proc_LimitsConfigured();
+int Proc_Count();
+Process* Proc_First();
+Process* Proc_Next(Process* proc);
+void Proc_Checkpoint(FILE* file);
+int Proc_Restore(CheckpointReader* reader);
+
+#endif // PROCESS_H
@@ -0,0 +1,78 @@
+#include <stdio.h>
+
+#include "readahead.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "pagetable.h"
+#include "process.h"
+
+/* Private Internals: */
+
+// Largest prefetch window, in pages (0 disables readahead)
+int maxWindow = 0;
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Enables swap-in readahead with windows of up to maxWindow pages. The window is also
+ * capped at half of physical memory so prefetching cannot flush the whole resident set.
+ */
+void Readahead_Init(int window) {
+    maxWindow = window;
+    if (maxWindow > NUM_FRAMES / 2) {
+        maxWindow = NUM_FRAMES / 2;
+    }
+}
+
+void Readahead_InitState(ReadaheadState* ra) {
+    ra->lastFault = -1;
+    ra->stride = 0;
+    ra->streak = 0;
+    ra->window = 1;
+}
+
+/*
+ * Called after a process faults a data page in from swap. Two faults in a row at the same
+ * (non zero) VPN stride are taken as a sequential or strided scan, and the next window
+ * of swapped out pages along that stride is brought in right away.
+ */
+void Readahead_Fault(int pid, int VPN) {
+    if (maxWindow == 0) {
+        return;
+    }
+    ReadaheadState* ra = &Proc_Get(pid)->readahead;
+    int stride = (ra->lastFault == -1) ? 0 : VPN - ra->lastFault;
+    if (stride != 0 && stride == ra->stride) {
+        ra->streak++;
+    } else {
+        ra->streak = 0;
+    }
+    ra->stride = stride;
+    ra->lastFault = VPN;
+    if (ra->streak == 0) {
+        return;
+    }
+
+    for (int i = 1; i <= ra->window; i++) {
+        int target = VPN + i * stride;
+        if (target < 0 || target >= VPN(VIRTUAL_SIZE)) {
+            break;
+        }
+        PT_Prefetch(pid, target);
+    }
+}
+
+/* A prefetched page was used before being evicted: read further ahead. */
+void Readahead_Hit(int pid) {
+    ReadaheadState* ra = &Proc_Get(pid)->readahead;
+    Proc_Get(pid)->stats.prefetchHits++;
+    ra->window = (ra->window * 2 > maxWindow) ? maxWindow : ra->window * 2;
+}
+
+/* A prefetched page was evicted without being used: read less ahead. */
+void Readahead_Wasted(int pid) {
+    ReadaheadState* ra = &Proc_Get(pid)->readahead;
+    ra->window = (ra->window > 1) ? ra->window / 2 : 1;
+}
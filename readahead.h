@@ -0,0 +1,22 @@
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+/*
+ * Public Interface:
+ */
+
+/* Per process fault pattern tracking, see readahead.c. */
+typedef struct {
+    int lastFault;   // VPN of the previous swap-in fault, -1 if none
+    int stride;      // VPN distance between the last two faults
+    int streak;      // Consecutive faults at that stride
+    int window;      // Pages to prefetch on the next patterned fault
+} ReadaheadState;
+
+void Readahead_Init(int maxWindow);
+void Readahead_InitState(ReadaheadState* ra);
+void Readahead_Fault(int pid, int VPN);
+void Readahead_Hit(int pid);
+void Readahead_Wasted(int pid);
+
+#endif // READAHEAD_H
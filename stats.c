@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stats.h"
+#include "mmu.h"
+#include "process.h"
+#include "pagetable.h"
+#include "memsim.h"
+#include "zswap.h"
+#include "tier.h"
+#include "cost.h"
+#include "arena.h"
+#include "ksm.h"
+#include "checkpoint.h"
+#include "eventlog.h"
+#include "numa.h"
+#include "adaptive.h"
+#include "pipeline.h"
+
+/* Private Internals: */
+
+long instructionCount = 0;
+
+// Frames reclaimed inline by a faulting instruction, and ahead of time by kswapd
+long directReclaims = 0;
+long backgroundReclaims = 0;
+
+// Pages swapped out as just a fill byte, new pages mapped to the zero frame, and
+// shared frames copied on a store
+long sameFilledPages = 0;
+long zeroPageMaps = 0;
+long cowBreaks = 0;
+
+// Sample reference bits every sampleInterval instructions (0 disables sampling)
+int sampleInterval = 0;
+
+// Working set window, in instructions
+int workingSetTau = 0;
+
+// Time series of samples, one CSV row per process per sample
+FILE* seriesFile = NULL;
+
+/*
+ * Test-and-clears the referenced bit of every page of a process whose page table is
+ * resident, stamping referenced pages with the current instruction count. A process
+ * whose page table is swapped out cannot have touched any page since it was evicted.
+ */
+void StatsSampleProcess(Process* proc) {
+    if (!proc->ptPresent) {
+        return;
+    }
+    for (int vpn = 0; vpn < VPN(VIRTUAL_SIZE); vpn++) {
+        if (PT_TestAndClearReferenced(proc->pid, vpn)) {
+            proc->stats.lastReference[vpn] = instructionCount;
+        }
+    }
+}
+
+/* Accounting of a process, or NULL if it does not exist. Hooks never create a process. */
+ProcStats* StatsOf(int pid) {
+    Process* proc = Proc_Lookup(pid);
+    return proc != NULL ? &proc->stats : NULL;
+}
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Sets up accounting. With a sample interval, reference bits are sampled every that many
+ * instructions and, if seriesPath is given, each sample is appended to it as CSV.
+ */
+void Stats_Init(int interval, int tau, const char* seriesPath) {
+    instructionCount = 0;
+    directReclaims = 0;
+    backgroundReclaims = 0;
+    sameFilledPages = 0;
+    zeroPageMaps = 0;
+    cowBreaks = 0;
+    sampleInterval = interval;
+    workingSetTau = (tau > 0) ? tau : 4 * interval;
+    if (seriesPath != NULL) {
+        seriesFile = fopen(seriesPath, "w");
+        if (seriesFile == NULL) {
+            printf("Error: could not open %s for writing.\n", seriesPath);
+        } else {
+            fprintf(seriesFile, "instruction,pid,rss,wss,swap,faults,fault_rate\n");
+        }
+    }
+}
+
+/* Counts an executed instruction and takes a sample when one is due. */
+void Stats_InstructionDone(int pid) {
+    Process* proc = Proc_Lookup(pid);
+    if (proc != NULL) {
+        proc->stats.instructions++;
+    }
+    instructionCount++;
+    if (sampleInterval > 0 && instructionCount % sampleInterval == 0) {
+        Stats_Sample();
+    }
+}
+
+long Stats_GetInstructionCount() {
+    return instructionCount;
+}
+
+void Stats_FrameClaimed(int pid) {
+    ProcStats* stats = StatsOf(pid);
+    if (stats == NULL) {
+        return;
+    }
+    stats->rss++;
+    if (stats->rss > stats->peakRss) {
+        stats->peakRss = stats->rss;
+    }
+}
+
+void Stats_FrameReleased(int pid) {
+    ProcStats* stats = StatsOf(pid);
+    if (stats != NULL) {
+        stats->rss--;
+    }
+}
+
+/* A same-filled page is swapped out as its fill byte, without taking a swap slot. */
+void Stats_PageSwappedOut(int pid, int usesSlot) {
+    ProcStats* stats = StatsOf(pid);
+    if (stats == NULL) {
+        return;
+    }
+    stats->evictions++;
+    if (usesSlot) {
+        stats->swapPages++;
+    }
+}
+
+/* A swap-in is always caused by an access, so it counts as a fault. */
+void Stats_PageSwappedIn(int pid, int usesSlot) {
+    ProcStats* stats = StatsOf(pid);
+    if (stats == NULL) {
+        return;
+    }
+    stats->faults++;
+    if (usesSlot) {
+        stats->swapPages--;
+    }
+}
+
+void Stats_DirectReclaim() {
+    directReclaims++;
+}
+
+void Stats_BackgroundReclaim() {
+    backgroundReclaims++;
+}
+
+void Stats_SameFilledPage() {
+    sameFilledPages++;
+}
+
+void Stats_ZeroPageMapped() {
+    zeroPageMaps++;
+}
+
+void Stats_COWBreak() {
+    cowBreaks++;
+}
+
+/* A swap-in done by readahead, ahead of any access. */
+void Stats_PagePrefetched(int pid, int usesSlot) {
+    ProcStats* stats = StatsOf(pid);
+    if (stats == NULL) {
+        return;
+    }
+    stats->prefetches++;
+    if (usesSlot) {
+        stats->swapPages--;
+    }
+}
+
+/*
+ * Samples reference bits of every process and writes one time series row per process:
+ * resident set, working set over the last tau instructions, pages in swap, faults since
+ * the previous sample and faults per instruction executed by the process in between.
+ */
+void Stats_Sample() {
+    for (Process* proc = Proc_First(); proc != NULL; proc = Proc_Next(proc)) {
+        StatsSampleProcess(proc);
+        if (seriesFile == NULL) {
+            continue;
+        }
+
+        ProcStats* stats = &proc->stats;
+        long faults = stats->faults - stats->sampleFaults;
+        long instructions = stats->instructions - stats->sampleInstructions;
+        fprintf(seriesFile, "%ld,%d,%d,%d,%d,%ld,%.4f\n", instructionCount, proc->pid,
+                stats->rss, Stats_WorkingSetSize(proc->pid), stats->swapPages, faults,
+                instructions > 0 ? (double)faults / instructions : 0.0);
+        stats->sampleFaults = stats->faults;
+        stats->sampleInstructions = stats->instructions;
+    }
+}
+
+/* Estimates WSS(tau): pages seen referenced within the last tau instructions. */
+int Stats_WorkingSetSize(int pid) {
+    Process* proc = Proc_Lookup(pid);
+    if (proc == NULL) {
+        return 0;
+    }
+    int wss = 0;
+    for (int vpn = 0; vpn < VPN(VIRTUAL_SIZE); vpn++) {
+        long last = proc->stats.lastReference[vpn];
+        if (last >= 0 && instructionCount - last < workingSetTau) {
+            wss++;
+        }
+    }
+    return wss;
+}
+
+/* Prints the accounting of every live process. */
+void Stats_Report() {
+    printf("Statistics after %ld instructions:\n", instructionCount);
+    printf("Reclaim: direct %ld, background %ld\n", directReclaims, backgroundReclaims);
+    Arena_Report();
+    Adaptive_Report();
+    Pipeline_Report();
+    if (Memsim_SwapChecksumErrors() > 0) {
+        printf("Swap checksum errors: %ld\n", Memsim_SwapChecksumErrors());
+    }
+    Zswap_Report();
+    Tier_Report();
+    Cost_Report();
+    Ksm_Report();
+    EventLog_Report();
+    Numa_Report();
+    if (sameFilledPages > 0 || zeroPageMaps > 0 || cowBreaks > 0) {
+        printf("Dedup: same-filled pages %ld, zero page maps %ld, copy-on-write breaks %ld\n",
+               sameFilledPages, zeroPageMaps, cowBreaks);
+    }
+    for (Process* proc = Proc_First(); proc != NULL; proc = Proc_Next(proc)) {
+        ProcStats* stats = &proc->stats;
+        printf("PID %d: instructions %ld, faults %ld, evictions %ld, rss %d (peak %d), swap %d",
+               proc->pid, stats->instructions, stats->faults, stats->evictions,
+               stats->rss, stats->peakRss, stats->swapPages);
+        if (sampleInterval > 0) {
+            printf(", wss %d", Stats_WorkingSetSize(proc->pid));
+        }
+        if (stats->prefetches > 0) {
+            printf(", prefetched %ld (used %ld, window %d)", stats->prefetches, stats->prefetchHits,
+                   proc->readahead.window);
+        }
+        long accesses = stats->localAccesses + stats->remoteAccesses;
+        if (Numa_Enabled() && accesses > 0) {
+            printf(", local %ld remote %ld (%.1f%% local, mean distance %.1f)",
+                   stats->localAccesses, stats->remoteAccesses,
+                   100.0 * stats->localAccesses / accesses, (double)stats->accessCost / accesses);
+        }
+        if (Cost_Enabled()) {
+            printf(", cycles %ld (slowdown %.2fx)", stats->cycles,
+                   Cost_Slowdown(stats->cycles, stats->translations));
+        }
+        if (proc->hardLimit > 0 || proc->softLimit > 0) {
+            printf(", limit %d/%d, limit reclaims %ld", proc->hardLimit, proc->softLimit,
+                   stats->limitReclaims);
+        }
+        printf("\n");
+    }
+}
+
+void Stats_Close() {
+    if (seriesFile != NULL) {
+        fclose(seriesFile);
+        seriesFile = NULL;
+    }
+}
+
+/* Saves the global counters. Sampling settings come from the command line of each run. */
+void Stats_Checkpoint(FILE* file) {
+    long counters[] = { instructionCount, directReclaims, backgroundReclaims,
+                        sameFilledPages, zeroPageMaps, cowBreaks };
+    Checkpoint_Write(file, counters, sizeof(counters));
+}
+
+int Stats_Restore(CheckpointReader* reader) {
+    long counters[6];
+    if (!Checkpoint_ReadInto(reader, counters, sizeof(counters))) {
+        return FALSE;
+    }
+    instructionCount = counters[0];
+    directReclaims = counters[1];
+    backgroundReclaims = counters[2];
+    sameFilledPages = counters[3];
+    zeroPageMaps = counters[4];
+    cowBreaks = counters[5];
+    return TRUE;
+}
@@ -0,0 +1,32 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+#include "checkpoint.h"
+
+/*
+ * Public Interface:
+ */
+
+void Stats_Init(int sampleInterval, int tau, const char* seriesPath);
+void Stats_InstructionDone(int pid);
+long Stats_GetInstructionCount();
+void Stats_FrameClaimed(int pid);
+void Stats_FrameReleased(int pid);
+void Stats_PageSwappedOut(int pid, int usesSlot);
+void Stats_PageSwappedIn(int pid, int usesSlot);
+void Stats_PagePrefetched(int pid, int usesSlot);
+void Stats_DirectReclaim();
+void Stats_BackgroundReclaim();
+void Stats_SameFilledPage();
+void Stats_ZeroPageMapped();
+void Stats_COWBreak();
+void Stats_Sample();
+int Stats_WorkingSetSize(int pid);
+void Stats_Report();
+void Stats_Close();
+void Stats_Checkpoint(FILE* file);
+int Stats_Restore(CheckpointReader* reader);
+
+#endif // STATS_H
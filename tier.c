@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tier.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "checkpoint.h"
+
+/* Private Internals: */
+
+// Far memory is a second, slower array of page frames. A page evicted from DRAM lands
+// there first, still owning its swap slot, and only reaches the swap device once it is
+// written back to make room. Pages in far memory are loaded and stored in place.
+int farFrames = 0;
+char* farMem = NULL;
+int* farSlot = NULL;            // Swap slot of the page in each far frame, -1 if free
+unsigned char* farHeat = NULL;  // Sampled accesses, aged by the writeback clock
+char* farPinned = NULL;         // In use by the current instruction
+int farUsed = 0;
+int farHand = 0;                // Writeback clock hand
+int farFreeCursor = 0;
+
+// Far frame holding each swap slot, or -1
+int slotFarFrame[NUM_SWAP_SLOTS];
+
+int tierLatency[3];
+int promoteThreshold = 0;
+int farSampleInterval = 1;
+long farSampleCounter = 0;
+
+long demotions = 0;
+long promotions = 0;
+long farWritebacks = 0;
+long tierAccesses[3];
+
+int TierFreeFrame() {
+    for (int i = 0; i < farFrames; i++) {
+        int far = (farFreeCursor + i) % farFrames;
+        if (farSlot[far] == -1) {
+            farFreeCursor = (far + 1) % farFrames;
+            return far;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Reads a far memory tier from a comma separated key=value list:
+ *   frames=pages dram=ns far=ns swap=ns promote=accesses sample=interval
+ * Returns FALSE (after printing why) if it is invalid.
+ */
+int Tier_Parse(const char* spec, TierSpec* out) {
+    out->frames = NUM_FRAMES;
+    out->latency[TIER_ACCESS_DRAM] = 100;
+    out->latency[TIER_ACCESS_FAR] = 300;
+    out->latency[TIER_ACCESS_SWAP] = 10000;
+    out->promoteThreshold = 4;
+    out->sampleInterval = 1;
+
+    char* copy = strdup(spec);
+    int ok = TRUE;
+    for (char* item = strtok(copy, ","); item != NULL && ok; item = strtok(NULL, ",")) {
+        char* value = strchr(item, '=');
+        if (value == NULL) {
+            ok = FALSE;
+            break;
+        }
+        *value++ = '\0';
+        if (strcmp(item, "frames") == 0) {
+            out->frames = atoi(value);
+        } else if (strcmp(item, "dram") == 0) {
+            out->latency[TIER_ACCESS_DRAM] = atoi(value);
+        } else if (strcmp(item, "far") == 0) {
+            out->latency[TIER_ACCESS_FAR] = atoi(value);
+        } else if (strcmp(item, "swap") == 0) {
+            out->latency[TIER_ACCESS_SWAP] = atoi(value);
+        } else if (strcmp(item, "promote") == 0) {
+            out->promoteThreshold = atoi(value);
+        } else if (strcmp(item, "sample") == 0) {
+            out->sampleInterval = atoi(value);
+        } else {
+            ok = FALSE;
+        }
+    }
+    free(copy);
+
+    if (!ok || out->frames < 0 || out->frames > NUM_SWAP_SLOTS || out->latency[0] < 0
+        || out->latency[1] < 0 || out->latency[2] < 0 || out->promoteThreshold < 0
+        || out->promoteThreshold > 255 || out->sampleInterval < 1) {
+        printf("Invalid far memory tier '%s'. Use key=value pairs among frames (0-%d), " \
+               "dram, far and swap (ns per access), promote (sampled accesses, 0 never, up to 255) " \
+               "and sample (every how many far accesses).\n", spec, NUM_SWAP_SLOTS);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Sets up far memory with the capacity and latencies of a spec (0 frames disables it). */
+void Tier_Init(const TierSpec* spec) {
+    free(farMem);
+    free(farSlot);
+    free(farHeat);
+    free(farPinned);
+    farFrames = spec->frames;
+    farMem = (farFrames > 0) ? calloc(farFrames, PAGE_SIZE) : NULL;
+    farSlot = (farFrames > 0) ? malloc(farFrames * sizeof(int)) : NULL;
+    farHeat = (farFrames > 0) ? calloc(farFrames, 1) : NULL;
+    farPinned = (farFrames > 0) ? calloc(farFrames, 1) : NULL;
+    for (int far = 0; far < farFrames; far++) {
+        farSlot[far] = -1;
+    }
+    for (int slot = 0; slot < NUM_SWAP_SLOTS; slot++) {
+        slotFarFrame[slot] = -1;
+    }
+    memcpy(tierLatency, spec->latency, sizeof(tierLatency));
+    promoteThreshold = spec->promoteThreshold;
+    farSampleInterval = spec->sampleInterval;
+    farUsed = farHand = farFreeCursor = 0;
+    farSampleCounter = demotions = promotions = farWritebacks = 0;
+    memset(tierAccesses, 0, sizeof(tierAccesses));
+}
+
+int Tier_Enabled() {
+    return farFrames > 0;
+}
+
+/* Demotes the page of a swap slot to far memory. Returns TIER_STORED or TIER_FULL. */
+int Tier_Store(int slot, const char* page) {
+    int far = TierFreeFrame();
+    if (far == -1) {
+        return TIER_FULL;
+    }
+    memcpy(&farMem[PAGE_START(far)], page, PAGE_SIZE);
+    farSlot[far] = slot;
+    farHeat[far] = 0;
+    slotFarFrame[slot] = far;
+    farUsed++;
+    demotions++;
+    return TIER_STORED;
+}
+
+/* Far frame holding the page of a swap slot, or -1 if it is not in far memory. */
+int Tier_Lookup(int slot) {
+    return (farFrames == 0) ? -1 : slotFarFrame[slot];
+}
+
+/* Copies the page of a swap slot out of far memory. Returns FALSE if it is not there. */
+int Tier_Load(int slot, char* page) {
+    int far = Tier_Lookup(slot);
+    if (far == -1) {
+        return FALSE;
+    }
+    memcpy(page, &farMem[PAGE_START(far)], PAGE_SIZE);
+    return TRUE;
+}
+
+/* Frees the far frame of a swap slot that is no longer used, or was swapped in. */
+void Tier_Invalidate(int slot) {
+    int far = Tier_Lookup(slot);
+    if (far == -1) {
+        return;
+    }
+    farSlot[far] = -1;
+    farPinned[far] = 0;
+    slotFarFrame[slot] = -1;
+    farUsed--;
+}
+
+/*
+ * Removes the coldest page from far memory so the caller can write it on to swap. A clock
+ * hand passes over the far frames, taking one sampled access off each page it skips.
+ * Returns the page's slot with its contents in page, or -1 if every page is pinned.
+ */
+int Tier_WritebackColdest(char* page) {
+    for (int step = 0; step < farFrames * (promoteThreshold + 2); step++) {
+        int far = farHand;
+        farHand = (farHand + 1) % farFrames;
+        if (farSlot[far] == -1 || farPinned[far]) {
+            continue;
+        }
+        if (farHeat[far] > 0) {
+            farHeat[far]--;
+            continue;
+        }
+        int slot = farSlot[far];
+        memcpy(page, &farMem[PAGE_START(far)], PAGE_SIZE);
+        Tier_Invalidate(slot);
+        farWritebacks++;
+        return slot;
+    }
+    return -1;
+}
+
+char* Tier_FrameData(int far) {
+    return &farMem[PAGE_START(far)];
+}
+
+int Tier_FrameSlot(int far) {
+    return farSlot[far];
+}
+
+/*
+ * Records a load or store to a page in far memory, pinning it for the instruction.
+ * Every farSampleInterval-th far access is sampled. Returns TRUE once the page has been
+ * sampled promoteThreshold times, and should move back to DRAM.
+ */
+int Tier_Access(int far) {
+    farPinned[far] = 1;
+    if (promoteThreshold == 0 || ++farSampleCounter % farSampleInterval != 0) {
+        return FALSE;
+    }
+    if (++farHeat[far] < promoteThreshold) {
+        return FALSE;
+    }
+    promotions++;
+    return TRUE;
+}
+
+void Tier_UnpinAll() {
+    for (int far = 0; far < farFrames; far++) {
+        farPinned[far] = 0;
+    }
+}
+
+void Tier_CountAccess(int where) {
+    tierAccesses[where]++;
+}
+
+void Tier_Report() {
+    if (farFrames == 0) {
+        return;
+    }
+    long accesses = 0, latency = 0;
+    for (int i = 0; i < 3; i++) {
+        accesses += tierAccesses[i];
+        latency += tierAccesses[i] * tierLatency[i];
+    }
+    printf("Far memory: %d/%d pages, demoted %ld, promoted %ld, written back %ld\n",
+           farUsed, farFrames, demotions, promotions, farWritebacks);
+    printf("Accesses: DRAM %ld, far %ld, swap %ld, modeled mean latency %.1f ns\n",
+           tierAccesses[TIER_ACCESS_DRAM], tierAccesses[TIER_ACCESS_FAR],
+           tierAccesses[TIER_ACCESS_SWAP], accesses > 0 ? (double)latency / accesses : 0.0);
+}
+
+/* Saves the far memory settings, its pages and its counters. */
+void Tier_Checkpoint(FILE* file) {
+    int settings[] = { farFrames, tierLatency[0], tierLatency[1], tierLatency[2],
+                       promoteThreshold, farSampleInterval, farHand, farFreeCursor };
+    long counters[] = { farSampleCounter, demotions, promotions, farWritebacks,
+                        tierAccesses[0], tierAccesses[1], tierAccesses[2] };
+    Checkpoint_Write(file, settings, sizeof(settings));
+    Checkpoint_Write(file, farMem, farFrames * PAGE_SIZE);
+    Checkpoint_Write(file, farSlot, farFrames * sizeof(int));
+    Checkpoint_Write(file, farHeat, farFrames);
+    Checkpoint_Write(file, counters, sizeof(counters));
+}
+
+/* Restores what Tier_Checkpoint saved, with the far memory it was taken with. */
+int Tier_Restore(CheckpointReader* reader) {
+    int settings[8];
+    long counters[7];
+    if (!Checkpoint_ReadInto(reader, settings, sizeof(settings))
+        || settings[0] < 0 || settings[0] > NUM_SWAP_SLOTS) {
+        return FALSE;
+    }
+    TierSpec spec = { settings[0], { settings[1], settings[2], settings[3] }, settings[4], settings[5] };
+    Tier_Init(&spec);
+    if (!Checkpoint_ReadInto(reader, farMem, farFrames * PAGE_SIZE)
+        || !Checkpoint_ReadInto(reader, farSlot, farFrames * sizeof(int))
+        || !Checkpoint_ReadInto(reader, farHeat, farFrames)
+        || !Checkpoint_ReadInto(reader, counters, sizeof(counters))) {
+        return FALSE;
+    }
+    for (int far = 0; far < farFrames; far++) {
+        if (farSlot[far] < -1 || farSlot[far] >= NUM_SWAP_SLOTS) {
+            return FALSE;
+        }
+        if (farSlot[far] != -1) {
+            slotFarFrame[farSlot[far]] = far;
+            farUsed++;
+        }
+    }
+    farHand = settings[6];
+    farFreeCursor = settings[7];
+    farSampleCounter = counters[0];
+    demotions = counters[1];
+    promotions = counters[2];
+    farWritebacks = counters[3];
+    memcpy(tierAccesses, &counters[4], sizeof(tierAccesses));
+    return TRUE;
+}
@@ -0,0 +1,46 @@
+#ifndef TIER_H
+#define TIER_H
+
+#include <stdio.h>
+
+#include "checkpoint.h"
+
+/*
+ * Public Interface:
+ */
+
+// Tier_Store results
+#define TIER_STORED 0   // Page kept in far memory
+#define TIER_FULL 1     // No room in far memory, write back a cold page and retry
+
+// Where a load or store was served from, for the modeled latency
+#define TIER_ACCESS_DRAM 0
+#define TIER_ACCESS_FAR 1
+#define TIER_ACCESS_SWAP 2
+
+/* Far memory size and modeled latencies, from a --tier key=value list. */
+typedef struct {
+    int frames;            // Far memory capacity in pages (0: off)
+    int latency[3];        // Modeled ns per access served from DRAM, far memory and swap
+    int promoteThreshold;  // Sampled accesses to a far page before it moves to DRAM
+    int sampleInterval;    // Every how many far accesses is sampled
+} TierSpec;
+
+int Tier_Parse(const char* spec, TierSpec* out);
+void Tier_Init(const TierSpec* spec);
+int Tier_Enabled();
+int Tier_Store(int slot, const char* page);
+int Tier_Lookup(int slot);
+int Tier_Load(int slot, char* page);
+void Tier_Invalidate(int slot);
+int Tier_WritebackColdest(char* page);
+char* Tier_FrameData(int far);
+int Tier_FrameSlot(int far);
+int Tier_Access(int far);
+void Tier_UnpinAll();
+void Tier_CountAccess(int where);
+void Tier_Report();
+void Tier_Checkpoint(FILE* file);
+int Tier_Restore(CheckpointReader* reader);
+
+#endif // TIER_H
@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "workload.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "input.h"
+#include "instruction.h"
+#include "kswapd.h"
+#include "ksm.h"
+#include "process.h"
+#include "cost.h"
+#include "arena.h"
+
+/* Private Internals: */
+
+// Generated instruction kinds
+#define WORKLOAD_OP_LOAD 0
+#define WORKLOAD_OP_STORE 1
+#define WORKLOAD_OP_MAP 2
+
+// xoshiro256** state, seeded through splitmix64 so any seed (including 0) works
+uint64_t rngState[4];
+
+uint64_t WorkloadSplitMix(uint64_t* x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void WorkloadSeed(uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        rngState[i] = WorkloadSplitMix(&seed);
+    }
+}
+
+uint64_t WorkloadRotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+uint64_t WorkloadNext() {
+    uint64_t result = WorkloadRotl(rngState[1] * 5, 7) * 9;
+    uint64_t t = rngState[1] << 17;
+    rngState[2] ^= rngState[0];
+    rngState[3] ^= rngState[1];
+    rngState[1] ^= rngState[2];
+    rngState[0] ^= rngState[3];
+    rngState[2] ^= t;
+    rngState[3] = WorkloadRotl(rngState[3], 45);
+    return result;
+}
+
+/* Uniform integer in [0, n), by multiplying instead of taking a (biased) modulo. */
+int WorkloadBelow(int n) {
+    return (int)(((WorkloadNext() >> 32) * (uint64_t)n) >> 32);
+}
+
+/* Uniform double in [0, 1). */
+double WorkloadUnit() {
+    return (WorkloadNext() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Cumulative Zipf weights of the pages of a process, normalized to end at 1
+double* zipfCDF = NULL;
+
+void WorkloadBuildZipf(int pages, double theta) {
+    zipfCDF = Arena_Alloc(pages * sizeof(double));
+    double sum = 0;
+    for (int rank = 1; rank <= pages; rank++) {
+        sum += 1.0 / pow(rank, theta);
+        zipfCDF[rank - 1] = sum;
+    }
+    for (int i = 0; i < pages; i++) {
+        zipfCDF[i] /= sum;
+    }
+}
+
+int WorkloadZipfPage(int pages) {
+    double u = WorkloadUnit();
+    int lo = 0, hi = pages - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (zipfCDF[mid] < u) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Number of hot pages of a process, at least one. */
+int WorkloadHotPages(const WorkloadSpec* spec) {
+    int hot = (int)(spec->hotFraction * spec->pages + 0.5);
+    return hot < 1 ? 1 : hot;
+}
+
+/* Hot/cold page choice, with the hot pages starting at hotStart and wrapping around. */
+int WorkloadHotColdPage(const WorkloadSpec* spec, int hotStart) {
+    int hot = WorkloadHotPages(spec);
+    if (hot >= spec->pages) {
+        return WorkloadBelow(spec->pages);
+    }
+    if (WorkloadUnit() < spec->hotAccesses) {
+        return (hotStart + WorkloadBelow(hot)) % spec->pages;
+    }
+    return (hotStart + hot + WorkloadBelow(spec->pages - hot)) % spec->pages;
+}
+
+/* Picks the virtual address of the i-th access, made by a process with a scan cursor. */
+int WorkloadAddress(const WorkloadSpec* spec, long i, int* cursor) {
+    int vpn;
+    switch (spec->distribution) {
+    case WORKLOAD_SEQUENTIAL: {
+        int va = *cursor;
+        *cursor = (*cursor + spec->stride) % (spec->pages * PAGE_SIZE);
+        return va;
+    }
+    case WORKLOAD_ZIPF:
+        vpn = WorkloadZipfPage(spec->pages);
+        break;
+    case WORKLOAD_HOTCOLD:
+        vpn = WorkloadHotColdPage(spec, 0);
+        break;
+    case WORKLOAD_PHASE:
+        // Each phase moves the hot pages along by their own size
+        vpn = WorkloadHotColdPage(spec, (int)((i / spec->phase) * WorkloadHotPages(spec) % spec->pages));
+        break;
+    default:
+        vpn = WorkloadBelow(spec->pages);
+        break;
+    }
+    return PAGE_START(vpn) + WorkloadBelow(PAGE_SIZE);
+}
+
+/* Runs one generated instruction the way MMUStart runs one read from input. */
+void WorkloadExecute(int op, int pid, int va, int value) {
+    MMU_LockMM();
+    Cost_SetProcess(pid);
+    if (op == WORKLOAD_OP_MAP) {
+        Instruction_Map(pid, va, value);
+    } else if (op == WORKLOAD_OP_STORE) {
+        Instruction_Store(pid, va, value);
+    } else {
+        Instruction_Load(pid, va);
+    }
+    Input_InstructionDone(pid);
+    Kswapd_Poke();
+    Ksm_Poke();
+    MMU_UnlockMM();
+}
+
+int WorkloadParseDistribution(const char* name) {
+    const char* names[] = { "uniform", "zipf", "seq", "hotcold", "phase" };
+    for (int i = 0; i < 5; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Public Interface:
+ */
+
+/*
+ * Reads a workload from a comma separated key=value list:
+ *   n=instructions procs=count pages=per-process writes=fraction seed=number quiet
+ *   dist=uniform|zipf|seq|hotcold|phase theta=zipf-exponent stride=seq-bytes
+ *   hot=fraction:accesses phase=instructions
+ * Unset keys keep their defaults. Returns FALSE (after printing why) if it is invalid.
+ */
+int Workload_Parse(const char* spec, WorkloadSpec* out) {
+    out->instructions = 1000;
+    out->procs = 4;
+    out->pages = VPN(VIRTUAL_SIZE);
+    out->writes = 0.3;
+    out->distribution = WORKLOAD_UNIFORM;
+    out->theta = 0.99;
+    out->hotFraction = 0.2;
+    out->hotAccesses = 0.8;
+    out->phase = 1000;
+    out->stride = PAGE_SIZE;
+    out->seed = 1;
+    out->quiet = FALSE;
+
+    char* copy = strdup(spec);
+    int ok = TRUE;
+    for (char* item = strtok(copy, ","); item != NULL && ok; item = strtok(NULL, ",")) {
+        char* value = strchr(item, '=');
+        if (value != NULL) {
+            *value++ = '\0';
+        }
+        if (strcmp(item, "quiet") == 0 && value == NULL) {
+            out->quiet = TRUE;
+        } else if (value == NULL) {
+            ok = FALSE;
+        } else if (strcmp(item, "n") == 0) {
+            out->instructions = atol(value);
+        } else if (strcmp(item, "procs") == 0) {
+            out->procs = atoi(value);
+        } else if (strcmp(item, "pages") == 0) {
+            out->pages = atoi(value);
+        } else if (strcmp(item, "writes") == 0) {
+            out->writes = atof(value);
+        } else if (strcmp(item, "dist") == 0) {
+            ok = (out->distribution = WorkloadParseDistribution(value)) != -1;
+        } else if (strcmp(item, "theta") == 0) {
+            out->theta = atof(value);
+        } else if (strcmp(item, "hot") == 0) {
+            ok = sscanf(value, "%lf:%lf", &out->hotFraction, &out->hotAccesses) == 2;
+        } else if (strcmp(item, "phase") == 0) {
+            out->phase = atol(value);
+        } else if (strcmp(item, "stride") == 0) {
+            out->stride = atoi(value);
+        } else if (strcmp(item, "seed") == 0) {
+            out->seed = strtoull(value, NULL, 10);
+        } else {
+            ok = FALSE;
+        }
+    }
+    free(copy);
+
+    if (!ok || out->instructions < 0 || out->procs < 1 || out->procs > MAX_PID + 1
+        || out->pages < 1 || out->pages > VPN(VIRTUAL_SIZE) || out->writes < 0 || out->writes > 1
+        || out->hotFraction <= 0 || out->hotFraction > 1 || out->hotAccesses < 0
+        || out->hotAccesses > 1 || out->phase < 1 || out->stride < 1) {
+        printf("Invalid workload '%s'. Use key=value pairs among n, procs, pages (1-%d), writes, "
+               "dist (uniform, zipf, seq, hotcold, phase), theta, hot=fraction:accesses, "
+               "phase, stride, seed, and quiet.\n", spec, VPN(VIRTUAL_SIZE));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Generates and executes a workload without going through text input. Each process first
+ * maps its pages writable, then loads and stores are issued by processes picked at random.
+ * The same spec always produces the same instructions.
+ */
+int Workload_Run(const WorkloadSpec* spec) {
+    WorkloadSeed(spec->seed);
+    if (spec->distribution == WORKLOAD_ZIPF) {
+        WorkloadBuildZipf(spec->pages, spec->theta);
+    }
+    int* cursors = Arena_Alloc(spec->procs * sizeof(int));
+
+    int savedStdout = -1;
+    if (spec->quiet) {
+        fflush(stdout);
+        savedStdout = dup(STDOUT_FILENO);
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        close(devNull);
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int pid = 0; pid < spec->procs; pid++) {
+        for (int vpn = 0; vpn < spec->pages; vpn++) {
+            WorkloadExecute(WORKLOAD_OP_MAP, pid, PAGE_START(vpn), 1);
+        }
+    }
+    long stores = 0;
+    for (long i = 0; i < spec->instructions; i++) {
+        int pid = WorkloadBelow(spec->procs);
+        int va = WorkloadAddress(spec, i, &cursors[pid]);
+        if (WorkloadUnit() < spec->writes) {
+            stores++;
+            WorkloadExecute(WORKLOAD_OP_STORE, pid, va, WorkloadBelow(256));
+        } else {
+            WorkloadExecute(WORKLOAD_OP_LOAD, pid, va, -1);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (spec->quiet) {
+        fflush(stdout);
+        dup2(savedStdout, STDOUT_FILENO);
+        close(savedStdout);
+    }
+
+    printf("Generated %ld loads and stores (%ld stores) for %d processes of %d pages.\n",
+           spec->instructions, stores, spec->procs, spec->pages);
+    if (spec->quiet) {
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("Ran in %.2f s, %.2f million instructions per second.\n", seconds,
+               seconds > 0 ? (spec->instructions + (long)spec->procs * spec->pages) / seconds / 1e6 : 0.0);
+    }
+    return 0;
+}
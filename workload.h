@@ -0,0 +1,36 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdint.h>
+
+/*
+ * Public Interface:
+ */
+
+// Access distributions over the pages of a process
+#define WORKLOAD_UNIFORM 0     // Every page equally likely
+#define WORKLOAD_ZIPF 1        // Page of rank r with weight 1/r^theta
+#define WORKLOAD_SEQUENTIAL 2  // Each process scans its address space, stride bytes at a time
+#define WORKLOAD_HOTCOLD 3     // hotFraction of the pages get hotAccesses of the accesses
+#define WORKLOAD_PHASE 4       // Hot/cold, with the hot pages moving every phase instructions
+
+/* Parameters of a generated workload, from a --gen key=value list. */
+typedef struct {
+    long instructions;   // Loads and stores, after each process has mapped its pages
+    int procs;           // Processes, pids 0 to procs-1
+    int pages;           // Pages mapped per process (address space size)
+    double writes;       // Fraction of accesses that are stores
+    int distribution;
+    double theta;        // Zipf exponent
+    double hotFraction;
+    double hotAccesses;
+    long phase;
+    int stride;
+    uint64_t seed;
+    int quiet;           // Discard per instruction output, print only the summary
+} WorkloadSpec;
+
+int Workload_Parse(const char* spec, WorkloadSpec* out);
+int Workload_Run(const WorkloadSpec* spec);
+
+#endif // WORKLOAD_H
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zswap.h"
+#include "mmu.h"
+#include "memsim.h"
+#include "checkpoint.h"
+
+/* Private Internals: */
+
+// The pool is carved into chunks, an entry takes a run of contiguous chunks
+#define ZSWAP_CHUNK_SIZE 8
+
+// Pages that do not compress to at most 3/4 of a page are not worth keeping
+#define ZSWAP_MAX_COMPRESSED (PAGE_SIZE * 3 / 4)
+
+// LZ token: a control byte below 0x80 is a run of (c + 1) literals, otherwise a match of
+// ((c & 0x7F) + LZ_MIN_MATCH) bytes at a 16-bit backwards offset
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (0x7F + LZ_MIN_MATCH)
+#define LZ_MAX_LITERALS 0x80
+#define LZ_HASH_SIZE 4096
+
+char* pool = NULL;
+unsigned char* chunkUsed = NULL;
+int numChunks = 0;
+
+// Per swap slot entries, kept on a list from least to most recently stored
+typedef struct {
+    int stored;
+    int chunk;       // First chunk of the compressed data
+    int length;      // Compressed bytes
+    int older;
+    int newer;
+} ZswapEntry;
+
+ZswapEntry entries[NUM_SWAP_SLOTS];
+int coldest = -1;
+int hottest = -1;
+
+long storedPages = 0;
+long rejectedPages = 0;
+long writtenBack = 0;
+long poolLoads = 0;
+long storedBytes = 0;     // Uncompressed bytes of the entries in the pool
+long compressedBytes = 0; // Their compressed size
+
+int ZswapHash(const unsigned char* p) {
+    return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> 20 & (LZ_HASH_SIZE - 1);
+}
+
+/*
+ * Greedy LZ77 compression of one page. Returns the compressed length, or -1 once the
+ * output would exceed maxLength.
+ */
+int ZswapCompress(const unsigned char* in, int length, unsigned char* out, int maxLength) {
+    int table[LZ_HASH_SIZE];
+    for (int i = 0; i < LZ_HASH_SIZE; i++) {
+        table[i] = -1;
+    }
+    int ip = 0, op = 0, literalStart = 0;
+
+    while (ip < length) {
+        int matchLength = 0, candidate = -1;
+        if (ip + LZ_MIN_MATCH <= length) {
+            int h = ZswapHash(&in[ip]);
+            candidate = table[h];
+            table[h] = ip;
+            if (candidate != -1 && ip - candidate <= 0xFFFF) {
+                while (ip + matchLength < length && matchLength < LZ_MAX_MATCH
+                       && in[candidate + matchLength] == in[ip + matchLength]) {
+                    matchLength++;
+                }
+            }
+        }
+        if (matchLength < LZ_MIN_MATCH && ip - literalStart < LZ_MAX_LITERALS) {
+            ip++;
+            continue;
+        }
+
+        int literals = ip - literalStart;
+        if (literals > 0) {
+            if (op + 1 + literals > maxLength) return -1;
+            out[op++] = literals - 1;
+            memcpy(&out[op], &in[literalStart], literals);
+            op += literals;
+        }
+        if (matchLength >= LZ_MIN_MATCH) {
+            if (op + 3 > maxLength) return -1;
+            int offset = ip - candidate;
+            out[op++] = 0x80 | (matchLength - LZ_MIN_MATCH);
+            out[op++] = offset & 0xFF;
+            out[op++] = offset >> 8;
+            ip += matchLength;
+        }
+        literalStart = ip;
+    }
+
+    int literals = ip - literalStart;
+    if (literals > 0) {
+        if (op + 1 + literals > maxLength) return -1;
+        out[op++] = literals - 1;
+        memcpy(&out[op], &in[literalStart], literals);
+        op += literals;
+    }
+    return op;
+}
+
+void ZswapDecompress(const unsigned char* in, int length, unsigned char* out) {
+    int ip = 0, op = 0;
+    while (ip < length) {
+        unsigned char control = in[ip++];
+        if (control < 0x80) {
+            memcpy(&out[op], &in[ip], control + 1);
+            ip += control + 1;
+            op += control + 1;
+        } else {
+            int matchLength = (control & 0x7F) + LZ_MIN_MATCH;
+            int offset = in[ip] | (in[ip + 1] << 8);
+            ip += 2;
+            for (int i = 0; i < matchLength; i++, op++) { // may overlap, copy bytewise
+                out[op] = out[op - offset];
+            }
+        }
+    }
+}
+
+/* First fit run of free chunks. Returns the first chunk, or -1 if there is none. */
+int ZswapAllocChunks(int count) {
+    int run = 0;
+    for (int i = 0; i < numChunks; i++) {
+        run = chunkUsed[i] ? 0 : run + 1;
+        if (run == count) {
+            memset(&chunkUsed[i - count + 1], 1, count);
+            return i - count + 1;
+        }
+    }
+    return -1;
+}
+
+void ZswapUnlink(int slot) {
+    ZswapEntry* e = &entries[slot];
+    if (e->older != -1) entries[e->older].newer = e->newer; else coldest = e->newer;
+    if (e->newer != -1) entries[e->newer].older = e->older; else hottest = e->older;
+}
+
+/*
+ * Public Interface:
+ */
+
+/* Enables the compressed swap cache with a pool of poolBytes (0 disables it). */
+void Zswap_Init(int poolBytes) {
+    free(pool);
+    free(chunkUsed);
+    numChunks = poolBytes / ZSWAP_CHUNK_SIZE;
+    pool = (numChunks > 0) ? malloc(numChunks * ZSWAP_CHUNK_SIZE) : NULL;
+    chunkUsed = (numChunks > 0) ? calloc(numChunks, 1) : NULL;
+    memset(entries, 0, sizeof(entries));
+    coldest = hottest = -1;
+    storedPages = rejectedPages = writtenBack = poolLoads = storedBytes = compressedBytes = 0;
+}
+
+int Zswap_Enabled() {
+    return numChunks > 0;
+}
+
+/*
+ * Tries to keep the page for a swap slot compressed in the pool instead of writing it to
+ * the swap file. Returns ZSWAP_STORED, ZSWAP_REJECTED or ZSWAP_FULL.
+ */
+int Zswap_Store(int slot, const char* page) {
+    unsigned char compressed[PAGE_SIZE];
+    int length = ZswapCompress((const unsigned char*)page, PAGE_SIZE, compressed, ZSWAP_MAX_COMPRESSED);
+    if (length == -1) {
+        rejectedPages++;
+        return ZSWAP_REJECTED;
+    }
+    int count = (length + ZSWAP_CHUNK_SIZE - 1) / ZSWAP_CHUNK_SIZE;
+    if (count == 0) count = 1;
+    if (count > numChunks) {
+        rejectedPages++;
+        return ZSWAP_REJECTED;
+    }
+    int chunk = ZswapAllocChunks(count);
+    if (chunk == -1) {
+        return ZSWAP_FULL;
+    }
+    memcpy(&pool[chunk * ZSWAP_CHUNK_SIZE], compressed, length);
+
+    ZswapEntry* e = &entries[slot];
+    e->stored = 1;
+    e->chunk = chunk;
+    e->length = length;
+    e->older = hottest;
+    e->newer = -1;
+    if (hottest != -1) entries[hottest].newer = slot; else coldest = slot;
+    hottest = slot;
+
+    storedPages++;
+    storedBytes += PAGE_SIZE;
+    compressedBytes += length;
+    return ZSWAP_STORED;
+}
+
+/* Decompresses the page of a swap slot if it is in the pool. Returns FALSE if it is not. */
+int Zswap_Load(int slot, char* page) {
+    if (numChunks == 0 || !entries[slot].stored) {
+        return FALSE;
+    }
+    ZswapDecompress((unsigned char*)&pool[entries[slot].chunk * ZSWAP_CHUNK_SIZE],
+                    entries[slot].length, (unsigned char*)page);
+    poolLoads++;
+    return TRUE;
+}
+
+/* Drops the entry of a swap slot that is no longer used. */
+void Zswap_Invalidate(int slot) {
+    ZswapEntry* e = &entries[slot];
+    if (numChunks == 0 || !e->stored) {
+        return;
+    }
+    int count = (e->length + ZSWAP_CHUNK_SIZE - 1) / ZSWAP_CHUNK_SIZE;
+    memset(&chunkUsed[e->chunk], 0, count > 0 ? count : 1);
+    ZswapUnlink(slot);
+    e->stored = 0;
+    storedBytes -= PAGE_SIZE;
+    compressedBytes -= e->length;
+}
+
+/*
+ * Removes the least recently stored entry from the pool so the caller can write it to the
+ * swap file. Returns its slot with the page decompressed into page, or -1 if the pool is empty.
+ */
+int Zswap_WritebackColdest(char* page) {
+    int slot = coldest;
+    if (slot == -1) {
+        return -1;
+    }
+    Zswap_Load(slot, page);
+    poolLoads--;
+    Zswap_Invalidate(slot);
+    writtenBack++;
+    return slot;
+}
+
+void Zswap_Report() {
+    if (numChunks == 0) {
+        return;
+    }
+    int used = 0;
+    for (int i = 0; i < numChunks; i++) {
+        used += chunkUsed[i];
+    }
+    printf("Zswap: stored %ld, rejected %ld, written back %ld, loads %ld, pool %d/%d bytes",
+           storedPages, rejectedPages, writtenBack, poolLoads,
+           used * ZSWAP_CHUNK_SIZE, numChunks * ZSWAP_CHUNK_SIZE);
+    if (compressedBytes > 0) {
+        printf(", ratio %.2f", (double)storedBytes / compressedBytes);
+    }
+    printf("\n");
+}
+
+/*
+ * Saves the pool, its counters and the entries of the slots it holds (not the whole
+ * per slot table, so an empty or disabled pool costs next to nothing).
+ */
+void Zswap_Checkpoint(FILE* file) {
+    long counters[] = { storedPages, rejectedPages, writtenBack, poolLoads, storedBytes, compressedBytes };
+    Checkpoint_Write(file, &numChunks, sizeof(numChunks));
+    Checkpoint_Write(file, pool, numChunks * ZSWAP_CHUNK_SIZE);
+    Checkpoint_Write(file, chunkUsed, numChunks);
+    int count = 0;
+    for (int slot = coldest; slot != -1; slot = entries[slot].newer) {
+        count++;
+    }
+    Checkpoint_Write(file, &count, sizeof(count));
+    for (int slot = coldest; slot != -1; slot = entries[slot].newer) {
+        Checkpoint_Write(file, &slot, sizeof(slot));
+        Checkpoint_Write(file, &entries[slot], sizeof(ZswapEntry));
+    }
+    Checkpoint_Write(file, &coldest, sizeof(coldest));
+    Checkpoint_Write(file, &hottest, sizeof(hottest));
+    Checkpoint_Write(file, counters, sizeof(counters));
+}
+
+/* Restores what Zswap_Checkpoint saved, with the pool size it was taken with. */
+int Zswap_Restore(CheckpointReader* reader) {
+    int chunks, count;
+    long counters[6];
+    if (!Checkpoint_ReadInto(reader, &chunks, sizeof(chunks))) {
+        return FALSE;
+    }
+    Zswap_Init(chunks * ZSWAP_CHUNK_SIZE);
+    if (!Checkpoint_ReadInto(reader, pool, numChunks * ZSWAP_CHUNK_SIZE)
+        || !Checkpoint_ReadInto(reader, chunkUsed, numChunks)
+        || !Checkpoint_ReadInto(reader, &count, sizeof(count))) {
+        return FALSE;
+    }
+    for (int i = 0; i < count; i++) {
+        int slot;
+        if (!Checkpoint_ReadInto(reader, &slot, sizeof(slot)) || slot < 0 || slot >= NUM_SWAP_SLOTS
+            || !Checkpoint_ReadInto(reader, &entries[slot], sizeof(ZswapEntry))) {
+            return FALSE;
+        }
+    }
+    if (!Checkpoint_ReadInto(reader, &coldest, sizeof(coldest))
+        || !Checkpoint_ReadInto(reader, &hottest, sizeof(hottest))
+        || !Checkpoint_ReadInto(reader, counters, sizeof(counters))) {
+        return FALSE;
+    }
+    storedPages = counters[0];
+    rejectedPages = counters[1];
+    writtenBack = counters[2];
+    poolLoads = counters[3];
+    storedBytes = counters[4];
+    compressedBytes = counters[5];
+    return TRUE;
+}
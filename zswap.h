@@ -0,0 +1,27 @@
+#ifndef ZSWAP_H
+#define ZSWAP_H
+
+#include <stdio.h>
+
+#include "checkpoint.h"
+
+/*
+ * Public Interface:
+ */
+
+// Zswap_Store results
+#define ZSWAP_STORED 0     // Page kept compressed in the pool
+#define ZSWAP_REJECTED 1   // Page compresses badly, write it to the swap file
+#define ZSWAP_FULL 2       // No room in the pool, write back a cold entry and retry
+
+void Zswap_Init(int poolBytes);
+int Zswap_Enabled();
+int Zswap_Store(int slot, const char* page);
+int Zswap_Load(int slot, char* page);
+void Zswap_Invalidate(int slot);
+int Zswap_WritebackColdest(char* page);
+void Zswap_Report();
+void Zswap_Checkpoint(FILE* file);
+int Zswap_Restore(CheckpointReader* reader);
+
+#endif // ZSWAP_H